@@ -34,8 +34,11 @@ int main(int argc, char **argv) {
 	try {
 		bool result = config.parseFile(argv[1]);
 		
+		logs::Level level;
+		if (result && logs::parseLevel(config.getLogLevel(), level))
+			logs::threshold = level;
 		if (result)
-			logs::msg(NOPORT, logs::Green, "Configuration file parsed successfully", true);
+			LOG_MSG(logs::Info, NOPORT, logs::Green, "Configuration file parsed successfully");
 	} 
 	catch (Config::ConfigException& e) {
 		std::cerr << "Error parsing configuration: " << e.what() << " (code: " << e.getCode() << ")" << std::endl;
@@ -17,8 +17,9 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <cctype>
 
-Config::Config() {
+Config::Config() : _logLevel(ConfigConstants::DEFAULT_LOG_LEVEL) {
 }
 
 Config::~Config() {
@@ -102,7 +103,8 @@ bool TokenHelper::isValidHttpMethod(const std::string& method) {
 
 /**
  * Validates file extensions for index files
- * Checks against supported web content and CGI script extensions
+ * Accepts web content and CGI script extensions, and any alphanumeric
+ * extension of a static file served with its media type
  * @param filename Filename to check
  * @return true if extension is supported
  */
@@ -121,12 +123,21 @@ bool TokenHelper::isValidFileExtension(const std::string& filename) {
     }
     
     size_t dotPos = filename.find_last_of('.');
-    if (dotPos == std::string::npos) {
+    if (dotPos == std::string::npos || dotPos + 1 == filename.size()) {
         return false;
     }
     
     std::string extension = filename.substr(dotPos);
-    return validExtensions.find(extension) != validExtensions.end();
+    if (validExtensions.find(extension) != validExtensions.end()) {
+        return true;
+    }
+    // any other static file, its media type comes from the types table
+    for (size_t i = 1; i < extension.size(); i++) {
+        if (!std::isalnum(static_cast<unsigned char>(extension[i]))) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
@@ -320,6 +331,9 @@ std::vector<ServerConfig> Config::parseServers(const std::vector<std::string>& t
         if (tokens[i] == "server") {
             servers.push_back(parseServerBlock(tokens, i, serverNames, serverPorts));
         } 
+        else if (tokens[i] == "log_level") {
+            parseLogLevel(tokens, i);
+        }
         else if (isNonServerSection(tokens[i])) {
             _nonServerSections.insert(tokens[i]);
             i = skipBlock(tokens, i + 1);
@@ -335,6 +349,24 @@ std::vector<ServerConfig> Config::parseServers(const std::vector<std::string>& t
     return servers;
 }
 
+/**
+ * Parses the global log_level directive: log_level debug|info|warn|error;
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ */
+void Config::parseLogLevel(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 2 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_LOG_LEVEL);
+    }
+    const std::string& level = tokens[i + 1];
+    if (level != "debug" && level != "info" && level != "warn" && level != "error") {
+        throw ConfigException(ERROR_INVALID_LOG_LEVEL);
+    }
+    _logLevel = level;
+    i += 2;
+    TokenHelper::expectSemicolon(tokens, i);
+}
+
 /**
  * Parses individual server configuration block
  * Handles all server-level directives and validates required configuration
@@ -376,6 +408,56 @@ ServerConfig Config::parseServerBlock(const std::vector<std::string>& tokens, si
         else if (tokens[i] == "root") {
             server._root = server.getRoot(tokens, i);
         }
+        else if (tokens[i] == "gzip") {
+            server._gzip.enabled = server.getGzip(tokens, i);
+        }
+        else if (tokens[i] == "gzip_comp_level") {
+            server._gzip.level = server.getGzipLevel(tokens, i);
+        }
+        else if (tokens[i] == "gzip_min_length") {
+            server._gzip.minLength = server.getGzipMinLength(tokens, i);
+        }
+        else if (tokens[i] == "gzip_types") {
+            server._gzip.types = server.getGzipTypes(tokens, i);
+        }
+        else if (tokens[i] == "types") {
+            std::map<std::string, std::string> types = server.getTypes(tokens, i);
+            for (std::map<std::string, std::string>::iterator it = types.begin(); it != types.end(); ++it)
+                server._mime.types[it->first] = it->second;
+        }
+        else if (tokens[i] == "default_type") {
+            server._mime.defaultType = server.getDefaultType(tokens, i);
+        }
+        else if (tokens[i] == "listen_backlog") {
+            server._sockets.backlog = server.getSocketValue(tokens, i, false);
+        }
+        else if (tokens[i] == "event_batch") {
+            server._sockets.eventBatch = server.getSocketValue(tokens, i, false);
+        }
+        else if (tokens[i] == "tcp_nodelay") {
+            server._sockets.tcpNoDelay = server.getSocketFlag(tokens, i);
+        }
+        else if (tokens[i] == "tcp_defer_accept") {
+            server._sockets.deferAccept = server.getSocketValue(tokens, i, true);
+        }
+        else if (tokens[i] == "tcp_fastopen") {
+            server._sockets.fastOpen = server.getSocketValue(tokens, i, true);
+        }
+        else if (tokens[i] == "so_rcvbuf") {
+            server._sockets.rcvBuf = server.getSocketValue(tokens, i, false);
+        }
+        else if (tokens[i] == "so_sndbuf") {
+            server._sockets.sndBuf = server.getSocketValue(tokens, i, false);
+        }
+        else if (tokens[i] == "large_client_header_buffers") {
+            server._headers = server.getHeaderBuffers(tokens, i);
+        }
+        else if (tokens[i] == "access_log") {
+            server._accessLog.path = server.getAccessLog(tokens, i);
+        }
+        else if (tokens[i] == "access_log_format") {
+            server._accessLog.format = server.getAccessLogFormat(tokens, i);
+        }
         else if (tokens[i] == "error_page") {
             parseErrorPage(tokens, i, server._errorPages);
         }
@@ -513,6 +595,7 @@ bool Config::parseFile(const std::string& filename) {
         throw ConfigException(ERROR_FILE_EMPTY);
     }
     
+    _filename = filename;
     try {
         _tokens = getTokensFromFile(file);
         
@@ -527,3 +610,11 @@ bool Config::parseFile(const std::string& filename) {
         throw;
     }
 }
+
+const std::string& Config::getFilename() const {
+    return _filename;
+}
+
+const std::string& Config::getLogLevel() const {
+    return _logLevel;
+}
@@ -32,6 +32,16 @@ namespace ConfigConstants {
     const std::string DEFAULT_HOST = "127.0.0.1";
     const std::string DEFAULT_SERVER_NAME = "localhost";
     const std::string DEFAULT_ROOT = "./www/";
+    const int DEFAULT_GZIP_LEVEL = 6;
+    const size_t DEFAULT_GZIP_MIN_LENGTH = 256;
+    const std::string DEFAULT_TYPE = "application/octet-stream";
+    const int DEFAULT_BACKLOG = 511;
+    const int DEFAULT_EVENT_BATCH = 256;
+    const size_t DEFAULT_HEADER_BUFFERS = 4;
+    const size_t DEFAULT_HEADER_BUFFER_SIZE = 8192;
+    const size_t MIN_HEADER_BUFFER_SIZE = 1024;
+    const std::string DEFAULT_LOG_LEVEL = "info";
+    const std::string DEFAULT_ACCESS_LOG_FORMAT = "$remote_addr [$time_local] \"$request\" $status $bytes_sent $request_time";
 }
 
 class Config {
@@ -39,6 +49,8 @@ private:
     std::vector<ServerConfig> _servers;
     std::vector<std::string> _tokens;
     std::set<std::string> _nonServerSections;
+    std::string _filename;
+    std::string _logLevel;
 
     // Core tokenization functions
     std::vector<std::string> tokenizeBasic(std::ifstream& file);
@@ -57,6 +69,7 @@ private:
     // Validation and utility functions
     void validateServerConfig(ServerConfig& server, bool hasPort,
                              std::map<std::pair<std::string, int>, bool>& serverPorts);
+    void parseLogLevel(const std::vector<std::string>& tokens, size_t& i);
     void parseErrorPage(const std::vector<std::string>& tokens, size_t& i,
                        std::map<int, std::string>& errorPages);
     void validateUniqueServerName(const std::string& name, std::set<std::string>& serverNames);
@@ -79,6 +92,9 @@ public:
      * @throws ConfigException on parsing errors
      */
     bool parseFile(const std::string& filename);
+
+    const std::string& getFilename() const;
+    const std::string& getLogLevel() const;
     
     friend class WebServer;
 
@@ -91,7 +107,8 @@ public:
         ERROR_UNEXPECTED_EOF,
         ERROR_INVALID_REDIRECT = 10,
         ERROR_LOOPING_REDIRECT,
-        ERROR_UNKNOWN_KEY = 20
+        ERROR_UNKNOWN_KEY = 20,
+        ERROR_INVALID_LOG_LEVEL
     };
 
     class ConfigException : public std::exception {
@@ -120,6 +137,8 @@ public:
                     return "Redirect loop detected in config";
                 case ERROR_UNKNOWN_KEY:
                     return "Unknown top-level configuration directive";
+                case ERROR_INVALID_LOG_LEVEL:
+                    return "Invalid log_level (expected debug, info, warn or error)";
                 default:
                     return "Unknown configuration error";
             }
@@ -12,11 +12,12 @@
 
 #include "LocationConfig.hpp"
 #include "Config.hpp"
+#include <cstdlib>
 
-LocationConfig::LocationConfig() : _locationRoot(ConfigConstants::DEFAULT_ROOT), _autoindex(false) {
+LocationConfig::LocationConfig() : _locationRoot(ConfigConstants::DEFAULT_ROOT), _autoindex(false), _gzipStatic(false), _metrics(false), _cgiCacheTtl(0) {
 }
 
-LocationConfig::LocationConfig(const std::string& root) : _locationRoot(root), _autoindex(false) {
+LocationConfig::LocationConfig(const std::string& root) : _locationRoot(root), _autoindex(false), _gzipStatic(false), _metrics(false), _cgiCacheTtl(0) {
 }
 
 LocationConfig::~LocationConfig() {
@@ -25,7 +26,7 @@ LocationConfig::~LocationConfig() {
 /**
  * Parses and validates index file configuration
  * Validates file extension, constructs full path, and checks file accessibility
- * Supports web content files (.html, .css, .txt, .ico) and CGI scripts (.py, .sh, .pl, .cgi)
+ * Supports static files of any media type and CGI scripts (.py, .sh, .pl, .cgi)
  * @param tokens Configuration tokens
  * @param i Current position in tokens (not modified - semicolon handled by caller)
  * @param rootPath Root directory for resolving relative index file path
@@ -136,6 +137,62 @@ bool LocationConfig::getAutoIndex(const std::vector<std::string>& tokens, size_t
     return autoindex;
 }
 
+/**
+ * Parses gzip_static directive (precompressed sidecar files)
+ * With "on", file.gz or file.br next to a static file is sent instead of
+ * the file when the client accepts that encoding
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return gzip_static setting (true for "on", false for "off")
+ */
+bool LocationConfig::getGzipStatic(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_GZIP_STATIC);
+    }
+    i++;
+
+    bool gzipStatic;
+    if (tokens[i] == "on") {
+        gzipStatic = true;
+    } else if (tokens[i] == "off") {
+        gzipStatic = false;
+    } else {
+        throw ConfigException(ERROR_INVALID_GZIP_STATIC);
+    }
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return gzipStatic;
+}
+
+/**
+ * Parses metrics directive
+ * With "on", the location answers GET with the server metrics in the
+ * Prometheus text format instead of serving files
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return metrics setting (true for "on", false for "off")
+ */
+bool LocationConfig::getMetrics(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_METRICS);
+    }
+    i++;
+
+    bool metrics;
+    if (tokens[i] == "on") {
+        metrics = true;
+    } else if (tokens[i] == "off") {
+        metrics = false;
+    } else {
+        throw ConfigException(ERROR_INVALID_METRICS);
+    }
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return metrics;
+}
+
 /**
  * Parses and validates CGI script path configuration
  * Constructs full path, validates file existence and execute permissions
@@ -166,3 +223,58 @@ std::string LocationConfig::getCgiPath(const std::vector<std::string>& tokens, s
     TokenHelper::expectSemicolon(tokens, i);
     return cgiPath;
 }
+
+/**
+ * Parses cgi_cache directive (response cache for CGI GET requests)
+ * Accepts "off" or a default TTL in seconds; a Cache-Control max-age
+ * emitted by the script overrides the default
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Default TTL in seconds (0 when caching is off)
+ */
+int LocationConfig::getCgiCache(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_CGI_CACHE);
+    }
+    i++;
+
+    int ttl = 0;
+    if (tokens[i] != "off") {
+        if (tokens[i].find_first_not_of("0123456789") != std::string::npos) {
+            throw ConfigException(ERROR_INVALID_CGI_CACHE);
+        }
+        ttl = std::atoi(tokens[i].c_str());
+        if (ttl <= 0) {
+            throw ConfigException(ERROR_INVALID_CGI_CACHE);
+        }
+    }
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return ttl;
+}
+
+/**
+ * Parses cgi_cache_key directive
+ * Lists the request headers whose values become part of the cache key,
+ * for scripts whose output depends on more than path and query string
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Vector of header names
+ */
+std::vector<std::string> LocationConfig::getCgiCacheKey(const std::vector<std::string>& tokens, size_t& i) {
+    std::vector<std::string> headers;
+
+    i++;
+    while (i < tokens.size() && tokens[i] != ";") {
+        headers.push_back(tokens[i]);
+        i++;
+    }
+
+    if (headers.empty()) {
+        throw ConfigException(ERROR_INVALID_CGI_CACHE);
+    }
+
+    TokenHelper::expectSemicolon(tokens, i);
+    return headers;
+}
@@ -27,14 +27,22 @@ private:
     std::vector<std::string> _allowedMethods;
     std::string _locationRoot;
     bool _autoindex;
+    bool _gzipStatic;
+    bool _metrics;
     std::string _cgiPath;
+    int _cgiCacheTtl;
+    std::vector<std::string> _cgiCacheKey;
 
     // Parsing functions
     std::string getIndex(const std::vector<std::string>& tokens, size_t i, const std::string& rootPath);
     std::vector<std::string> getAllowedMethods(const std::vector<std::string>& tokens, size_t& i);
     std::string getRoot(const std::vector<std::string>& tokens, size_t& i);
     bool getAutoIndex(const std::vector<std::string>& tokens, size_t& i);
+    bool getGzipStatic(const std::vector<std::string>& tokens, size_t& i);
+    bool getMetrics(const std::vector<std::string>& tokens, size_t& i);
     std::string getCgiPath(const std::vector<std::string>& tokens, size_t& i);
+    int getCgiCache(const std::vector<std::string>& tokens, size_t& i);
+    std::vector<std::string> getCgiCacheKey(const std::vector<std::string>& tokens, size_t& i);
 
 public:
     LocationConfig();
@@ -47,7 +55,11 @@ public:
     const std::string& getLocationIndex() const { return _index; }
     const std::vector<std::string>& getLocationAllowedMethods() const { return _allowedMethods; }
     bool getLocationAutoIndex() const { return _autoindex; }
+    bool getLocationGzipStatic() const { return _gzipStatic; }
+    bool getLocationMetrics() const { return _metrics; }
     const std::string& getLocationCgiPath() const { return _cgiPath; }
+    int getLocationCgiCacheTtl() const { return _cgiCacheTtl; }
+    const std::vector<std::string>& getLocationCgiCacheKey() const { return _cgiCacheKey; }
 
     friend class ServerConfig;
     friend class Config;
@@ -74,6 +86,9 @@ public:
         ERROR_INVALID_ERROR_PAGE,
         ERROR_INVALID_CGI_PATH,
         ERROR_INVALID_AUTOINDEX = 240,
+        ERROR_INVALID_CGI_CACHE,
+        ERROR_INVALID_GZIP_STATIC,
+        ERROR_INVALID_METRICS,
         ERROR_UNKNOWN_KEY = 250
     };
 
@@ -125,6 +140,12 @@ public:
                     return "Invalid CGI path (must be executable file)";
                 case ERROR_INVALID_AUTOINDEX:
                     return "Invalid autoindex value (use 'on' or 'off')";
+                case ERROR_INVALID_CGI_CACHE:
+                    return "Invalid cgi_cache value (use 'off' or a TTL in seconds)";
+                case ERROR_INVALID_GZIP_STATIC:
+                    return "Invalid gzip_static value (use 'on' or 'off')";
+                case ERROR_INVALID_METRICS:
+                    return "Invalid metrics value (use 'on' or 'off')";
                 case ERROR_UNKNOWN_KEY:
                     return "Unknown directive in location block";
                 default:
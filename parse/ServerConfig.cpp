@@ -23,6 +23,24 @@ ServerConfig::ServerConfig() : _root(ConfigConstants::DEFAULT_ROOT), _clientBody
 ServerConfig::~ServerConfig() {
 }
 
+GzipConfig::GzipConfig() : enabled(false), level(ConfigConstants::DEFAULT_GZIP_LEVEL),
+    minLength(ConfigConstants::DEFAULT_GZIP_MIN_LENGTH) {
+    types.insert("text/html");
+}
+
+MimeConfig::MimeConfig() : defaultType(ConfigConstants::DEFAULT_TYPE) {
+}
+
+SocketConfig::SocketConfig() : backlog(ConfigConstants::DEFAULT_BACKLOG), eventBatch(ConfigConstants::DEFAULT_EVENT_BATCH),
+    tcpNoDelay(true), deferAccept(0), fastOpen(0), rcvBuf(0), sndBuf(0) {
+}
+
+AccessLogConfig::AccessLogConfig() : format(ConfigConstants::DEFAULT_ACCESS_LOG_FORMAT) {
+}
+
+HeaderConfig::HeaderConfig() : buffers(ConfigConstants::DEFAULT_HEADER_BUFFERS), bufferSize(ConfigConstants::DEFAULT_HEADER_BUFFER_SIZE) {
+}
+
 /**
  * Parses port configuration from listen directive
  * Handles single or multiple port specifications with proper validation
@@ -163,6 +181,288 @@ std::string ServerConfig::getServerName(const std::vector<std::string>& tokens,
     return name;
 }
 
+/**
+ * Parses gzip directive (on-the-fly compression of generated responses)
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return gzip setting (true for "on", false for "off")
+ */
+bool ServerConfig::getGzip(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+    i++;
+
+    bool gzip;
+    if (tokens[i] == "on") {
+        gzip = true;
+    } else if (tokens[i] == "off") {
+        gzip = false;
+    } else {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return gzip;
+}
+
+/**
+ * Parses gzip_comp_level directive (zlib compression level)
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Level between 1 (fastest) and 9 (smallest)
+ */
+int ServerConfig::getGzipLevel(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+    i++;
+
+    if (tokens[i].size() != 1 || tokens[i][0] < '1' || tokens[i][0] > '9') {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+    int level = tokens[i][0] - '0';
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return level;
+}
+
+/**
+ * Parses gzip_min_length directive
+ * Responses with a shorter body are not worth compressing; streamed
+ * bodies have no known length and are always compressed
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Minimum body length in bytes
+ */
+size_t ServerConfig::getGzipMinLength(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+    i++;
+
+    if (tokens[i].empty() || tokens[i].find_first_not_of("0123456789") != std::string::npos) {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+    size_t length = std::strtoul(tokens[i].c_str(), NULL, 10);
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return length;
+}
+
+/**
+ * Parses gzip_types directive
+ * Media types compressed in addition to text/html, which always is
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Set of media types
+ */
+std::set<std::string> ServerConfig::getGzipTypes(const std::vector<std::string>& tokens, size_t& i) {
+    std::set<std::string> types;
+    types.insert("text/html");
+
+    i++;
+    while (i < tokens.size() && tokens[i] != ";") {
+        if (tokens[i].find('/') == std::string::npos) {
+            throw ConfigException(ERROR_INVALID_GZIP);
+        }
+        types.insert(tokens[i]);
+        i++;
+    }
+    if (types.size() < 2) {
+        throw ConfigException(ERROR_INVALID_GZIP);
+    }
+
+    TokenHelper::expectSemicolon(tokens, i);
+    return types;
+}
+
+/**
+ * Parses types block (media types by file extension)
+ * Each entry is a media type followed by its extensions:
+ * types { image/avif avif; text/markdown md markdown; }
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after closing brace
+ * @return Map of extension to media type
+ */
+std::map<std::string, std::string> ServerConfig::getTypes(const std::vector<std::string>& tokens, size_t& i) {
+    std::map<std::string, std::string> types;
+
+    i++; // Skip "types"
+    if (i >= tokens.size() || tokens[i] != "{") {
+        throw ConfigException(ERROR_INVALID_TYPES);
+    }
+    i++;
+    while (i < tokens.size() && tokens[i] != "}") {
+        std::string type = tokens[i];
+        if (type == ";" || type.find('/') == std::string::npos) {
+            throw ConfigException(ERROR_INVALID_TYPES);
+        }
+        i++;
+        size_t first = i;
+        while (i < tokens.size() && tokens[i] != ";" && tokens[i] != "}") {
+            if (tokens[i].find_first_of("./") != std::string::npos) {
+                throw ConfigException(ERROR_INVALID_TYPES);
+            }
+            types[tokens[i]] = type;
+            i++;
+        }
+        if (i == first) {
+            throw ConfigException(ERROR_INVALID_TYPES);
+        }
+        TokenHelper::expectSemicolon(tokens, i);
+    }
+    if (i >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_TYPES);
+    }
+    i++; // Skip closing brace
+    return types;
+}
+
+/**
+ * Parses default_type directive
+ * Media type sent for extensions missing from the types table
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Default media type
+ */
+std::string ServerConfig::getDefaultType(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size() || tokens[i + 1].find('/') == std::string::npos) {
+        throw ConfigException(ERROR_INVALID_TYPES);
+    }
+    i++;
+    std::string type = tokens[i];
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return type;
+}
+
+/**
+ * Parses a numeric socket directive (listen_backlog, event_batch,
+ * tcp_defer_accept, tcp_fastopen, so_rcvbuf, so_sndbuf)
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @param allowOff Whether "off" is accepted, standing for 0
+ * @return Positive value, or 0 for "off"
+ */
+int ServerConfig::getSocketValue(const std::vector<std::string>& tokens, size_t& i, bool allowOff) {
+    if (i + 1 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_SOCKET_OPTION);
+    }
+    i++;
+
+    int value = 0;
+    if (!allowOff || tokens[i] != "off") {
+        if (tokens[i].empty() || tokens[i].size() > 9
+            || tokens[i].find_first_not_of("0123456789") != std::string::npos) {
+            throw ConfigException(ERROR_INVALID_SOCKET_OPTION);
+        }
+        value = std::atoi(tokens[i].c_str());
+        if (value <= 0) {
+            throw ConfigException(ERROR_INVALID_SOCKET_OPTION);
+        }
+    }
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return value;
+}
+
+/**
+ * Parses an on/off socket directive (tcp_nodelay)
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return true for "on", false for "off"
+ */
+bool ServerConfig::getSocketFlag(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size() || (tokens[i + 1] != "on" && tokens[i + 1] != "off")) {
+        throw ConfigException(ERROR_INVALID_SOCKET_OPTION);
+    }
+    i++;
+    bool flag = tokens[i] == "on";
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return flag;
+}
+
+/**
+ * Parses the request head limits: large_client_header_buffers 4 8k;
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Buffer count and size (the size accepts a k suffix)
+ */
+HeaderConfig ServerConfig::getHeaderBuffers(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 2 >= tokens.size()) {
+        throw ConfigException(ERROR_INVALID_HEADER_BUFFERS);
+    }
+    HeaderConfig headers;
+    const std::string& count = tokens[i + 1];
+    std::string size = tokens[i + 2];
+    size_t multiplier = 1;
+    if (!size.empty() && (size[size.size() - 1] == 'k' || size[size.size() - 1] == 'K')) {
+        multiplier = 1024;
+        size.erase(size.size() - 1);
+    }
+    if (count.empty() || count.size() > 4 || count.find_first_not_of("0123456789") != std::string::npos
+        || size.empty() || size.size() > 6 || size.find_first_not_of("0123456789") != std::string::npos) {
+        throw ConfigException(ERROR_INVALID_HEADER_BUFFERS);
+    }
+    headers.buffers = std::atoi(count.c_str());
+    headers.bufferSize = std::atoi(size.c_str()) * multiplier;
+    if (headers.buffers == 0 || headers.bufferSize < ConfigConstants::MIN_HEADER_BUFFER_SIZE) {
+        throw ConfigException(ERROR_INVALID_HEADER_BUFFERS);
+    }
+
+    i += 3;
+    TokenHelper::expectSemicolon(tokens, i);
+    return headers;
+}
+
+/**
+ * Parses the access log destination: access_log path; or access_log off;
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Log file path, empty for "off"
+ */
+std::string ServerConfig::getAccessLog(const std::vector<std::string>& tokens, size_t& i) {
+    if (i + 1 >= tokens.size() || tokens[i + 1] == ";") {
+        throw ConfigException(ERROR_INVALID_ACCESS_LOG);
+    }
+    i++;
+    std::string path = (tokens[i] == "off") ? "" : tokens[i];
+
+    i++;
+    TokenHelper::expectSemicolon(tokens, i);
+    return path;
+}
+
+/**
+ * Parses the access log line format, every word up to the semicolon,
+ * joined by single spaces (variables are checked when the log opens)
+ * @param tokens Configuration tokens
+ * @param i Current position in tokens, updated to position after semicolon
+ * @return Format string
+ */
+std::string ServerConfig::getAccessLogFormat(const std::vector<std::string>& tokens, size_t& i) {
+    std::string format;
+    for (i++; i < tokens.size() && tokens[i] != ";"; i++) {
+        if (tokens[i] == "{" || tokens[i] == "}") {
+            throw ConfigException(ERROR_INVALID_ACCESS_LOG);
+        }
+        format += (format.empty() ? "" : " ") + tokens[i];
+    }
+    if (format.empty()) {
+        throw ConfigException(ERROR_INVALID_ACCESS_LOG);
+    }
+    TokenHelper::expectSemicolon(tokens, i);
+    return format;
+}
+
 /**
  * Parses location configuration block and creates LocationConfig objects
  * Handles location path extraction, block parsing, and inheritance of server settings
@@ -204,9 +504,21 @@ std::map<std::string, LocationConfig> ServerConfig::getLocationConfig(const std:
         else if (tokens[i] == "autoindex") {
             locationConfig._autoindex = locationConfig.getAutoIndex(tokens, i);
         }
+        else if (tokens[i] == "gzip_static") {
+            locationConfig._gzipStatic = locationConfig.getGzipStatic(tokens, i);
+        }
+        else if (tokens[i] == "metrics") {
+            locationConfig._metrics = locationConfig.getMetrics(tokens, i);
+        }
         else if (tokens[i] == "cgi_path") {
             locationConfig._cgiPath = locationConfig.getCgiPath(tokens, i);
         }
+        else if (tokens[i] == "cgi_cache") {
+            locationConfig._cgiCacheTtl = locationConfig.getCgiCache(tokens, i);
+        }
+        else if (tokens[i] == "cgi_cache_key") {
+            locationConfig._cgiCacheKey = locationConfig.getCgiCacheKey(tokens, i);
+        }
         else if (tokens[i] == "return") {
             // Skip redirection directive
             if (i + 2 >= tokens.size()) {
@@ -15,9 +15,58 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <iostream>
 #include "LocationConfig.hpp"
 
+// On-the-fly compression of generated responses (gzip directives)
+struct GzipConfig {
+    bool enabled;
+    int level;
+    size_t minLength;
+    std::set<std::string> types;
+
+    GzipConfig();
+};
+
+// Listener and connection socket tuning; 0 leaves a value to the system
+struct SocketConfig {
+    int backlog;
+    int eventBatch;
+    bool tcpNoDelay;
+    int deferAccept; // seconds
+    int fastOpen; // pending fast open requests
+    int rcvBuf;
+    int sndBuf;
+
+    SocketConfig();
+};
+
+// Request head limits: the request line must fit in one buffer, the
+// whole header section in all of them
+struct HeaderConfig {
+    size_t buffers;
+    size_t bufferSize;
+
+    HeaderConfig();
+};
+
+// Access log file ("" when off) and line format
+struct AccessLogConfig {
+    std::string path;
+    std::string format;
+
+    AccessLogConfig();
+};
+
+// Media types by file extension (types block), on top of the built-in table
+struct MimeConfig {
+    std::map<std::string, std::string> types;
+    std::string defaultType;
+
+    MimeConfig();
+};
+
 class ServerConfig {
 private:
     std::vector<int> _port;
@@ -27,6 +76,11 @@ private:
     ssize_t _clientBodyLimit;
     std::map<int, std::string> _errorPages;
     std::map<std::string, LocationConfig> _locations;
+    GzipConfig _gzip;
+    MimeConfig _mime;
+    SocketConfig _sockets;
+    HeaderConfig _headers;
+    AccessLogConfig _accessLog;
 
     // Parsing functions
     std::vector<int> getPort(const std::vector<std::string>& tokens, size_t& i);
@@ -34,6 +88,17 @@ private:
     std::string getRoot(const std::vector<std::string>& tokens, size_t& i);
     ssize_t getClientBodyLimit(const std::vector<std::string>& tokens, size_t& i);
     std::string getServerName(const std::vector<std::string>& tokens, size_t& i);
+    bool getGzip(const std::vector<std::string>& tokens, size_t& i);
+    int getGzipLevel(const std::vector<std::string>& tokens, size_t& i);
+    size_t getGzipMinLength(const std::vector<std::string>& tokens, size_t& i);
+    std::set<std::string> getGzipTypes(const std::vector<std::string>& tokens, size_t& i);
+    std::map<std::string, std::string> getTypes(const std::vector<std::string>& tokens, size_t& i);
+    std::string getDefaultType(const std::vector<std::string>& tokens, size_t& i);
+    int getSocketValue(const std::vector<std::string>& tokens, size_t& i, bool allowOff);
+    bool getSocketFlag(const std::vector<std::string>& tokens, size_t& i);
+    HeaderConfig getHeaderBuffers(const std::vector<std::string>& tokens, size_t& i);
+    std::string getAccessLog(const std::vector<std::string>& tokens, size_t& i);
+    std::string getAccessLogFormat(const std::vector<std::string>& tokens, size_t& i);
     std::map<std::string, LocationConfig> getLocationConfig(const std::vector<std::string>& tokens, size_t& i);
 
 public:
@@ -58,6 +123,11 @@ public:
         ERROR_INVALID_REDIRECT = 120,
         ERROR_LOOPING_REDIRECT,
         ERROR_INVALID_CLIENT_MAX_BODY_SIZE = 130,
+        ERROR_INVALID_GZIP,
+        ERROR_INVALID_TYPES,
+        ERROR_INVALID_SOCKET_OPTION,
+        ERROR_INVALID_HEADER_BUFFERS,
+        ERROR_INVALID_ACCESS_LOG,
         ERROR_UNKNOWN_KEY = 140
     };
 
@@ -95,6 +165,16 @@ public:
                     return "Redirect loop detected in server block";
                 case ERROR_INVALID_CLIENT_MAX_BODY_SIZE:
                     return "Invalid client_max_body_size value (must be positive)";
+                case ERROR_INVALID_GZIP:
+                    return "Invalid gzip value (gzip on/off, gzip_comp_level 1-9, gzip_min_length and gzip_types)";
+                case ERROR_INVALID_TYPES:
+                    return "Invalid types block or default_type (media type followed by extensions)";
+                case ERROR_INVALID_SOCKET_OPTION:
+                    return "Invalid socket option (positive number, 'off' where allowed, tcp_nodelay on/off)";
+                case ERROR_INVALID_HEADER_BUFFERS:
+                    return "Invalid large_client_header_buffers (expected: number size, size in bytes or with k suffix)";
+                case ERROR_INVALID_ACCESS_LOG:
+                    return "Invalid access_log or access_log_format (expected: access_log path|off; access_log_format text with $variables;)";
                 case ERROR_UNKNOWN_KEY:
                     return "Unknown directive in server block";
                 default:
@@ -0,0 +1,251 @@
+#include "AccessLog.hpp"
+#include "utils.hpp"
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+AccessLog::AccessLog()
+	: _head(0), _tail(0), _dropped(0), _reportedDrops(0), _stopping(false), _running(false), _stampTime(0)
+{
+	_stamp[0] = '\0';
+}
+
+AccessLog::~AccessLog()
+{
+	stop();
+	for (std::map<std::string, int>::iterator it = _files.begin(); it != _files.end(); ++it)
+		close(it->second);
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// Adds a sink; a file named by several servers is opened once
+int		AccessLog::open(const std::string& path, const std::string& format)
+{
+	Sink sink;
+	sink.format = compile(format);
+	std::map<std::string, int>::iterator file = _files.find(path);
+	if (file != _files.end())
+		sink.fd = file->second;
+	else
+	{
+		sink.fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (sink.fd == -1)
+			throw std::runtime_error("Failed to open access log " + path + ": " + strerror(errno));
+		_files[path] = sink.fd;
+	}
+	_sinks.push_back(sink);
+	return (_sinks.size() - 1);
+}
+
+std::vector<AccessLog::Field>	AccessLog::compile(const std::string& format)
+{
+	static const struct { const char* name; Variable variable; } variables[] = {
+		{ "remote_addr", REMOTE_ADDR }, { "time_local", TIME_LOCAL }, { "request_method", REQUEST_METHOD },
+		{ "request_uri", REQUEST_URI }, { "request_time", REQUEST_TIME }, { "request", REQUEST },
+		{ "status", STATUS }, { "bytes_sent", BYTES_SENT }, { "server_port", SERVER_PORT }
+	};
+	std::vector<Field> fields;
+	Field literal;
+	literal.variable = LITERAL;
+	for (size_t i = 0; i < format.size();)
+	{
+		size_t end = i + 1;
+		while (format[i] == '$' && end < format.size() && (std::islower(format[end]) || format[end] == '_'))
+			end++;
+		if (format[i] != '$' || end == i + 1)
+		{
+			literal.literal += format[i++];
+			continue ;
+		}
+		std::string name = format.substr(i + 1, end - i - 1);
+		size_t known = 0;
+		while (known < sizeof(variables) / sizeof(variables[0]) && name != variables[known].name)
+			known++;
+		if (known == sizeof(variables) / sizeof(variables[0]))
+			throw std::runtime_error("Unknown access_log_format variable $" + name);
+		if (!literal.literal.empty())
+			fields.push_back(literal);
+		literal.literal.clear();
+		Field field;
+		field.variable = variables[known].variable;
+		fields.push_back(field);
+		i = end;
+	}
+	literal.literal += '\n';
+	fields.push_back(literal);
+	return (fields);
+}
+
+void	AccessLog::start()
+{
+	if (_running || _sinks.empty())
+		return ;
+	_ring.resize(ACCESS_LOG_SLOTS);
+	_stopping = false;
+	// signals stay with the event loop thread
+	sigset_t all, previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	_running = pthread_create(&_thread, NULL, flushMain, this) == 0;
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (!_running)
+		throw std::runtime_error("Failed to start the access log thread");
+}
+
+// Flushes what is still in the ring before the thread exits
+void	AccessLog::stop()
+{
+	if (!_running)
+		return ;
+	_stopping = true;
+	pthread_join(_thread, NULL);
+	_running = false;
+}
+
+// Event loop side: never blocks, a full ring loses the entry
+bool	AccessLog::push(const AccessEntry& entry)
+{
+	if (!_running)
+		return (false);
+	size_t tail = _tail;
+	if (tail - _head >= ACCESS_LOG_SLOTS)
+	{
+		__sync_fetch_and_add(&_dropped, 1);
+		return (false);
+	}
+	_ring[tail & (ACCESS_LOG_SLOTS - 1)] = entry;
+	__sync_synchronize(); // the entry is complete before the slot is published
+	_tail = tail + 1;
+	return (true);
+}
+
+void*	AccessLog::flushMain(void* log)
+{
+	static_cast<AccessLog *>(log)->flushLoop();
+	return (NULL);
+}
+
+void	AccessLog::flushLoop()
+{
+	while (true)
+	{
+		bool stopping = _stopping;
+		if (!drain())
+		{
+			if (stopping)
+				return ;
+			usleep(ACCESS_LOG_FLUSH_US);
+		}
+	}
+}
+
+// Formats every published entry, then writes each sink in one go
+bool	AccessLog::drain()
+{
+	size_t head = _head;
+	size_t tail = _tail;
+	__sync_synchronize();
+	if (head == tail)
+		return (false);
+	for (; head != tail; head++)
+	{
+		const AccessEntry& entry = _ring[head & (ACCESS_LOG_SLOTS - 1)];
+		format(entry, _sinks[entry.sink]);
+	}
+	__sync_synchronize(); // entries are read before their slots are handed back
+	_head = tail;
+	for (size_t i = 0; i < _sinks.size(); i++)
+	{
+		std::string& pending = _sinks[i].pending;
+		if (!pending.empty())
+			writeAll(_sinks[i].fd, pending.data(), pending.size());
+		pending.clear();
+	}
+	unsigned long dropped = _dropped;
+	if (dropped != _reportedDrops)
+	{
+		char line[96];
+		int length = snprintf(line, sizeof(line), "access_log: %lu entries dropped (%lu in total)\n",
+			dropped - _reportedDrops, dropped);
+		writeAll(2, line, length);
+		_reportedDrops = dropped;
+	}
+	return (true);
+}
+
+void	AccessLog::format(const AccessEntry& entry, Sink& sink)
+{
+	char number[32];
+	for (size_t i = 0; i < sink.format.size(); i++)
+	{
+		switch (sink.format[i].variable)
+		{
+			case LITERAL:
+				sink.pending += sink.format[i].literal;
+				break ;
+			case REMOTE_ADDR:
+				if (inet_ntop(AF_INET, &entry.address, number, sizeof(number)))
+					sink.pending += number;
+				break ;
+			case TIME_LOCAL:
+				if (entry.time != _stampTime)
+				{
+					struct tm local;
+					localtime_r(&entry.time, &local);
+					strftime(_stamp, sizeof(_stamp), "%d/%b/%Y:%H:%M:%S %z", &local);
+					_stampTime = entry.time;
+				}
+				sink.pending += _stamp;
+				break ;
+			case REQUEST:
+				sink.pending += entry.method;
+				sink.pending += ' ';
+				sink.pending += entry.path;
+				break ;
+			case REQUEST_METHOD:
+				sink.pending += entry.method;
+				break ;
+			case REQUEST_URI:
+				sink.pending += entry.path;
+				break ;
+			case STATUS:
+				snprintf(number, sizeof(number), "%d", entry.status);
+				sink.pending += number;
+				break ;
+			case BYTES_SENT:
+				snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(entry.bytes));
+				sink.pending += number;
+				break ;
+			case REQUEST_TIME:
+				snprintf(number, sizeof(number), "%llu.%03llu", entry.latency / 1000000, entry.latency / 1000 % 1000);
+				sink.pending += number;
+				break ;
+			case SERVER_PORT:
+				snprintf(number, sizeof(number), "%d", entry.port);
+				sink.pending += number;
+				break ;
+		}
+	}
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+unsigned long	AccessLog::getDropped() const
+{
+	return (_dropped);
+}
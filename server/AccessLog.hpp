@@ -0,0 +1,89 @@
+#ifndef ACCESSLOG_HPP
+#define ACCESSLOG_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ctime>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#define ACCESS_LOG_SLOTS 4096 // ring capacity, a power of two
+#define ACCESS_LOG_PATH_MAX 256 // request targets are cut at this length
+#define ACCESS_LOG_FLUSH_US 50000 // flush thread sleep when the ring is empty
+
+// One finished request, copied into the ring as plain bytes
+struct AccessEntry
+{
+	struct in_addr		address;
+	int					port;
+	int					status;
+	int					sink;
+	size_t				bytes;
+	unsigned long long	latency; // microseconds
+	time_t				time;
+	char				method[8];
+	char				path[ACCESS_LOG_PATH_MAX];
+};
+
+/*
+*	Access log. The event loop copies each finished request into a single
+*	producer / single consumer ring and goes on; a background thread turns
+*	entries into lines and writes each log file with one write() per batch.
+*	A full ring drops the entry instead of blocking the loop, and the drops
+*	are counted and reported on stderr.
+*	Every access_log of the configuration is a sink: a file and a format
+*	compiled from $variables ($remote_addr, $time_local, $request,
+*	$request_method, $request_uri, $status, $bytes_sent, $request_time,
+*	$server_port). Sinks are opened before start().
+*/
+class AccessLog
+{
+	private:
+		enum Variable { LITERAL, REMOTE_ADDR, TIME_LOCAL, REQUEST, REQUEST_METHOD, REQUEST_URI,
+			STATUS, BYTES_SENT, REQUEST_TIME, SERVER_PORT };
+		struct Field
+		{
+			Variable	variable;
+			std::string	literal;
+		};
+		struct Sink
+		{
+			int					fd;
+			std::vector<Field>	format;
+			std::string			pending;
+		};
+		std::vector<Sink>			_sinks;
+		std::map<std::string, int>	_files; // path -> fd shared by its sinks
+		std::vector<AccessEntry>	_ring;
+		volatile size_t				_head; // next entry to flush, flush thread only
+		volatile size_t				_tail; // next free slot, event loop only
+		volatile unsigned long		_dropped;
+		unsigned long				_reportedDrops;
+		volatile bool				_stopping;
+		bool						_running;
+		time_t						_stampTime; // $time_local of the last second formatted
+		char						_stamp[32];
+		pthread_t					_thread;
+		// Prevent Copying
+		AccessLog(const AccessLog& other);
+		AccessLog&					operator=(const AccessLog& other);
+
+		static std::vector<Field>	compile(const std::string& format);
+		static void*				flushMain(void* log);
+		void						flushLoop();
+		bool						drain();
+		void						format(const AccessEntry& entry, Sink& sink);
+
+	public:
+		AccessLog();
+		~AccessLog();
+
+		int							open(const std::string& path, const std::string& format);
+		void						start();
+		void						stop();
+		bool						push(const AccessEntry& entry);
+		unsigned long				getDropped() const;
+};
+
+#endif
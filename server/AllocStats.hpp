@@ -0,0 +1,39 @@
+#ifndef ALLOCSTATS_HPP
+#define ALLOCSTATS_HPP
+
+/*
+*	Hooks for the allocation-counting build (make webserv_alloc). Each
+*	ALLOC_PHASE marks the rest of its scope as one phase of request
+*	handling; the interposer in tools/alloc_count.cpp charges every
+*	malloc and operator new to the phase of the calling thread.
+*	In the normal build the macros expand to nothing.
+*/
+namespace allocstats
+{
+	enum Phase { OTHER, ACCEPT, PARSE, ROUTE, HANDLE, WRITE, PHASES };
+
+	Phase	enter(Phase phase);
+	void	leave(Phase previous);
+	void	requestDone();
+
+	class Scope
+	{
+		private:
+			Phase	_previous;
+			Scope(const Scope& other);
+			Scope&	operator=(const Scope& other);
+		public:
+			explicit Scope(Phase phase) : _previous(enter(phase)) {}
+			~Scope() { leave(_previous); }
+	};
+}
+
+#ifdef ALLOC_COUNT
+# define ALLOC_PHASE(phase) allocstats::Scope allocPhase_(allocstats::phase)
+# define ALLOC_REQUEST_DONE() allocstats::requestDone()
+#else
+# define ALLOC_PHASE(phase)
+# define ALLOC_REQUEST_DONE()
+#endif
+
+#endif
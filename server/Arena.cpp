@@ -0,0 +1,122 @@
+#include "Arena.hpp"
+#include <cstring>
+#include <new>
+
+// allocations keep the alignment malloc would have given them
+static const size_t ARENA_ALIGN = 2 * sizeof(void *);
+static const size_t HEADER_SIZE = (sizeof(void *) + 2 * sizeof(size_t) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+
+Arena::Chunk*	Arena::_spare = NULL;
+size_t			Arena::_spareCount = 0;
+
+Arena::Arena() : _chunks(NULL)
+{
+}
+
+Arena::~Arena()
+{
+	reset();
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+Arena::Chunk*	Arena::newChunk(size_t size, Chunk* next)
+{
+	Chunk* chunk;
+	if (size == ARENA_CHUNK && _spare)
+	{
+		chunk = _spare;
+		_spare = chunk->next;
+		_spareCount--;
+	}
+	else
+		chunk = static_cast<Chunk *>(::operator new(HEADER_SIZE + size));
+	chunk->next = next;
+	chunk->size = size;
+	chunk->used = 0;
+	return (chunk);
+}
+
+char*	Arena::data(Chunk* chunk)
+{
+	return (reinterpret_cast<char *>(chunk) + HEADER_SIZE);
+}
+
+void*	Arena::allocate(size_t size)
+{
+	size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	if (!_chunks || _chunks->size - _chunks->used < size)
+	{
+		size_t chunkSize = ARENA_CHUNK;
+		while (chunkSize < size)
+			chunkSize *= 2;
+		_chunks = newChunk(chunkSize, _chunks);
+	}
+	void* memory = data(_chunks) + _chunks->used;
+	_chunks->used += size;
+	return (memory);
+}
+
+// NUL-terminated copy, usable where the system wants a C string
+char*	Arena::copy(const char* str, size_t length)
+{
+	char* out = static_cast<char *>(allocate(length + 1));
+	std::memcpy(out, str, length);
+	out[length] = '\0';
+	return (out);
+}
+
+char*	Arena::join(const char* a, size_t aLength, const char* b, size_t bLength)
+{
+	char* out = static_cast<char *>(allocate(aLength + bLength + 1));
+	std::memcpy(out, a, aLength);
+	std::memcpy(out + aLength, b, bLength);
+	out[aLength + bLength] = '\0';
+	return (out);
+}
+
+void	Arena::reset()
+{
+	while (_chunks)
+	{
+		Chunk* next = _chunks->next;
+		if (_chunks->size == ARENA_CHUNK && _spareCount < ARENA_SPARE_MAX)
+		{
+			_chunks->next = _spare;
+			_spare = _chunks;
+			_spareCount++;
+		}
+		else
+			::operator delete(_chunks);
+		_chunks = next;
+	}
+}
+
+void	Arena::releaseSpare()
+{
+	while (_spare)
+	{
+		Chunk* next = _spare->next;
+		::operator delete(_spare);
+		_spare = next;
+	}
+	_spareCount = 0;
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+size_t	Arena::used() const
+{
+	size_t total = 0;
+	for (Chunk* chunk = _chunks; chunk; chunk = chunk->next)
+		total += chunk->used;
+	return (total);
+}
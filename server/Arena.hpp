@@ -0,0 +1,50 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+
+#define ARENA_CHUNK 4096 // standard chunk size, enough for a typical request
+#define ARENA_SPARE_MAX 256 // standard chunks kept for the next request
+
+/*
+*	Per-request bump allocator for the temporaries of parsing and routing
+*	(path slices, joined file paths). Nothing is freed on its own: reset()
+*	drops everything at once when the request is done. Standard chunks go
+*	to a spare list shared by every arena, so an idle connection holds no
+*	arena memory and a busy one in steady state never goes back to malloc.
+*	Memory is raw bytes: only trivially destructible data goes here.
+*	Event loop thread only.
+*/
+class Arena
+{
+	private:
+		struct Chunk
+		{
+			Chunk*	next;
+			size_t	size;
+			size_t	used;
+		};
+		Chunk*		_chunks; // newest first
+		// Prevent Copying
+		Arena(const Arena& other);
+		Arena&		operator=(const Arena& other);
+
+		static Chunk*	_spare; // shared by every arena
+		static size_t	_spareCount;
+
+		static Chunk*	newChunk(size_t size, Chunk* next);
+		static char*	data(Chunk* chunk);
+
+	public:
+		Arena();
+		~Arena();
+
+		void*		allocate(size_t size);
+		char*		copy(const char* str, size_t length);
+		char*		join(const char* a, size_t aLength, const char* b, size_t bLength);
+		void		reset();
+		static void	releaseSpare();
+		size_t		used() const;
+};
+
+#endif
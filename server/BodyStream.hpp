@@ -0,0 +1,27 @@
+#ifndef BODYSTREAM_HPP
+#define BODYSTREAM_HPP
+
+#include <string>
+#include <sys/types.h>
+
+/*
+*	A response body produced piece by piece while the socket drains.
+*	read() appends the next piece to out and returns false once the body
+*	is complete. Generated bodies are sent with chunked transfer encoding;
+*	file-backed ones have a Content-Length and interleave read() text with
+*	ranges sent straight from the file by sendFile(). share() copies a
+*	body nothing has been read from yet for another client, or returns
+*	NULL when it cannot be.
+*/
+class BodyStream
+{
+	public:
+		virtual ~BodyStream() {}
+		virtual bool	read(std::string& out) = 0;
+		virtual bool	isChunked() const { return (true); }
+		virtual bool	hasFileRange() const { return (false); }
+		virtual ssize_t	sendFile(int socketFd) { (void)socketFd; return (-1); }
+		virtual BodyStream*	share() const { return (NULL); }
+};
+
+#endif
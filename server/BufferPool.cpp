@@ -0,0 +1,57 @@
+#include "BufferPool.hpp"
+
+BufferPool::BufferPool()
+{
+	_idle.reserve(IO_BUFFER_POOL_MAX);
+}
+
+BufferPool::~BufferPool()
+{
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// Gives an empty buffer IO_BUFFER_SIZE bytes of room, from the pool if any
+void	BufferPool::borrow(std::string& buffer)
+{
+	if (buffer.capacity() >= IO_BUFFER_SIZE)
+		return ;
+	if (_idle.empty())
+	{
+		buffer.reserve(IO_BUFFER_SIZE);
+		return ;
+	}
+	std::string kept;
+	kept.swap(buffer);
+	buffer.swap(_idle.back());
+	_idle.pop_back();
+	buffer.append(kept);
+}
+
+void	BufferPool::giveBack(std::string& buffer)
+{
+	buffer.clear();
+	if (buffer.capacity() >= IO_BUFFER_SIZE && buffer.capacity() <= 2 * IO_BUFFER_SIZE
+		&& _idle.size() < IO_BUFFER_POOL_MAX)
+	{
+		_idle.push_back(std::string());
+		_idle.back().swap(buffer);
+	}
+	else
+		std::string().swap(buffer);
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+size_t	BufferPool::idle() const
+{
+	return (_idle.size());
+}
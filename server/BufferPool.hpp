@@ -0,0 +1,37 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <string>
+#include <vector>
+
+#define IO_BUFFER_SIZE 16384 // capacity of a pooled request or response buffer
+#define IO_BUFFER_POOL_MAX 256 // idle buffers kept for the next borrower
+
+/*
+*	Shared I/O buffers for connections. A client borrows a buffer when it
+*	starts reading a request or writing a response and gives it back once
+*	the exchange is over, so an idle keep-alive connection holds no buffer
+*	at all. Buffers that grew past twice the pooled size (a large upload
+*	or page) are freed instead of kept, which bounds what the pool and the
+*	connections pin after a burst.
+*	Buffers move by swap, the bytes themselves are never copied.
+*	Event loop thread only.
+*/
+class BufferPool
+{
+	private:
+		std::vector<std::string>	_idle;
+		// Prevent Copying
+		BufferPool(const BufferPool& other);
+		BufferPool&					operator=(const BufferPool& other);
+
+	public:
+		BufferPool();
+		~BufferPool();
+
+		void						borrow(std::string& buffer);
+		void						giveBack(std::string& buffer);
+		size_t						idle() const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "CgiCache.hpp"
+#include "utils.hpp"
+
+CgiCache::CgiCache(size_t maxBytes) : _bytes(0), _maxBytes(maxBytes)
+{
+}
+
+CgiCache::~CgiCache()
+{
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+bool	CgiCache::lookup(const std::string& key, std::string& response)
+{
+	std::map<std::string, Entry>::iterator it = _entries.find(key);
+	if (it == _entries.end())
+		return (false);
+	if (it->second.expires <= time(0))
+	{
+		erase(it);
+		return (false);
+	}
+	_lru.splice(_lru.begin(), _lru, it->second.lruPos);
+	response = it->second.response;
+	return (true);
+}
+
+void	CgiCache::store(const std::string& key, const std::string& response, time_t ttl)
+{
+	size_t cost = key.size() + response.size();
+	if (ttl <= 0 || cost > _maxBytes)
+		return ;
+	std::map<std::string, Entry>::iterator it = _entries.find(key);
+	if (it != _entries.end())
+		erase(it);
+	if (_bytes + cost > _maxBytes)
+	{
+		time_t now = time(0);
+		for (it = _entries.begin(); it != _entries.end();)
+		{
+			std::map<std::string, Entry>::iterator current = it++;
+			if (current->second.expires <= now)
+				erase(current);
+		}
+	}
+	while (_bytes + cost > _maxBytes && !_lru.empty())
+		erase(_entries.find(_lru.back()));
+	_lru.push_front(key);
+	Entry &entry = _entries[key];
+	entry.response = response;
+	entry.expires = time(0) + ttl;
+	entry.lruPos = _lru.begin();
+	_bytes += cost;
+}
+
+void	CgiCache::erase(std::map<std::string, Entry>::iterator it)
+{
+	_bytes -= it->first.size() + it->second.response.size();
+	_lru.erase(it->second.lruPos);
+	_entries.erase(it);
+}
+
+size_t	CgiCache::getBytes() const
+{
+	return (_bytes);
+}
+
+// key = port, script and query string, followed by the value of every header
+// the location listed in cgi_cache_key (a missing header still counts)
+std::string	CgiCache::buildKey(const std::string& scriptPath, const std::string& queryString, int port, const std::vector<std::string>& keyHeaders, const std::map<std::string, std::string>& headers)
+{
+	std::string key = to_string(port) + '\n' + scriptPath + '?' + queryString;
+	for (std::vector<std::string>::const_iterator it = keyHeaders.begin(); it != keyHeaders.end(); ++it)
+	{
+		std::map<std::string, std::string>::const_iterator header = headers.find(*it);
+		key += '\n' + *it + ':';
+		if (header != headers.end())
+			key += header->second;
+	}
+	return (key);
+}
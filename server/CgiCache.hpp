@@ -0,0 +1,47 @@
+#ifndef CGICACHE_HPP
+#define CGICACHE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <ctime>
+
+#define CGI_CACHE_MAX_BYTES 4194304 // 4mb shared by every cached response of a server
+
+/*
+*	TTL cache of complete CGI responses for idempotent (GET) requests.
+*	Entries are evicted when they expire or, least recently used first,
+*	when the cache grows past its byte budget.
+*/
+class CgiCache
+{
+	private:
+		struct Entry
+		{
+			std::string							response;
+			time_t								expires;
+			std::list<std::string>::iterator	lruPos;
+		};
+		std::map<std::string, Entry>	_entries;
+		std::list<std::string>			_lru; // front is the most recently used key
+		size_t							_bytes;
+		size_t							_maxBytes;
+
+		void							erase(std::map<std::string, Entry>::iterator it);
+		// Prevent Copying
+		CgiCache(const CgiCache& other);
+		CgiCache&						operator=(const CgiCache& other);
+
+	public:
+		CgiCache(size_t maxBytes = CGI_CACHE_MAX_BYTES);
+		~CgiCache();
+
+		bool							lookup(const std::string& key, std::string& response);
+		void							store(const std::string& key, const std::string& response, time_t ttl);
+		size_t							getBytes() const;
+
+		static std::string				buildKey(const std::string& scriptPath, const std::string& queryString, int port, const std::vector<std::string>& keyHeaders, const std::map<std::string, std::string>& headers);
+};
+
+#endif
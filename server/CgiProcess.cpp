@@ -0,0 +1,120 @@
+#include "CgiProcess.hpp"
+#include "Client.hpp"
+#include "utils.hpp"
+#include <unistd.h>
+
+CgiProcess::CgiProcess(pid_t pid, int stdoutFd, int stdinFd, const std::string& input, const Client* client)
+	: _pid(pid), _stdoutFd(stdoutFd), _stdinFd(stdinFd), _input(input), _inputOffset(0), _output(), _startTime(time(0)), _startMicros(monotonicMicros()), _timedOut(false),
+	  _clientFd(client->getClientSocketFd()), _clientId(client->getId()),
+	  _cacheKey(), _cacheable(false), _coalesced(false), _defaultTtl(0)
+{
+}
+
+CgiProcess::~CgiProcess()
+{
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// Writes as much of the body as the pipe accepts; returns false once the
+// whole body is written or the script stopped reading
+bool	CgiProcess::writeInput()
+{
+	ssize_t written = write(_stdinFd, _input.data() + _inputOffset, _input.size() - _inputOffset);
+	if (written <= 0)
+		return (false);
+	_inputOffset += written;
+	if (_inputOffset < _input.size())
+		return (true);
+	std::string().swap(_input);
+	return (false);
+}
+
+void	CgiProcess::appendOutput(const char* data, size_t length)
+{
+	_output.append(data, length);
+}
+
+bool	CgiProcess::hasExpired(time_t now) const
+{
+	return (now - _startTime >= CGI_TIMEOUT);
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+pid_t				CgiProcess::getPid() const {
+	return (_pid);
+}
+
+int					CgiProcess::getStdoutFd() const {
+	return (_stdoutFd);
+}
+
+int					CgiProcess::getStdinFd() const {
+	return (_stdinFd);
+}
+
+const std::string&	CgiProcess::getOutput() const {
+	return (_output);
+}
+
+bool				CgiProcess::getTimedOut() const {
+	return (_timedOut);
+}
+
+unsigned long long	CgiProcess::getStartMicros() const {
+	return (_startMicros);
+}
+
+int					CgiProcess::getClientFd() const {
+	return (_clientFd);
+}
+
+unsigned long		CgiProcess::getClientId() const {
+	return (_clientId);
+}
+
+const std::string&	CgiProcess::getCacheKey() const {
+	return (_cacheKey);
+}
+
+bool				CgiProcess::getCacheable() const {
+	return (_cacheable);
+}
+
+bool				CgiProcess::getCoalesced() const {
+	return (_coalesced);
+}
+
+int					CgiProcess::getDefaultTtl() const {
+	return (_defaultTtl);
+}
+
+/*
+┌───────────────────────────────────┐
+│              SETTER               │
+└───────────────────────────────────┘
+*/
+
+void				CgiProcess::setTimedOut(bool timedOut) {
+	_timedOut = timedOut;
+}
+
+void				CgiProcess::setStdinFd(int stdinFd) {
+	_stdinFd = stdinFd;
+}
+
+void				CgiProcess::setCaching(const std::string& cacheKey, bool cacheable, bool coalesced, int defaultTtl) {
+	_cacheKey = cacheKey;
+	_cacheable = cacheable;
+	_coalesced = coalesced;
+	_defaultTtl = defaultTtl;
+}
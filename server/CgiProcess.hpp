@@ -0,0 +1,79 @@
+#ifndef CGIPROCESS_HPP
+#define CGIPROCESS_HPP
+
+#include <string>
+#include <ctime>
+#include <sys/types.h>
+
+#define CGI_TIMEOUT 10 // seconds before a silent script is killed
+
+class Client;
+
+/*
+*	A running CGI child. Both of its pipes live in the shared epoll set:
+*	the request body is written to stdin as the pipe drains (EPOLLOUT)
+*	while stdout is read as the script produces output. The client that
+*	started it (and, through the server's SingleFlight, every identical
+*	request) stays suspended until the script exits or times out.
+*/
+class CgiProcess
+{
+	private:
+		pid_t			_pid;
+		int				_stdoutFd;
+		int				_stdinFd;
+		std::string		_input;
+		size_t			_inputOffset;
+		std::string		_output;
+		time_t			_startTime;
+		unsigned long long	_startMicros; // monotonic, for the run time metric
+		bool			_timedOut;
+		// client that started the script
+		int				_clientFd;
+		unsigned long	_clientId;
+		// caching and coalescing
+		std::string		_cacheKey;
+		bool			_cacheable;
+		bool			_coalesced;
+		int				_defaultTtl;
+		// Prevent Copying
+		CgiProcess(const CgiProcess& other);
+		CgiProcess&		operator=(const CgiProcess& other);
+
+	public:
+		CgiProcess(pid_t pid, int stdoutFd, int stdinFd, const std::string& input, const Client* client);
+		~CgiProcess();
+
+		bool				writeInput();
+		void				appendOutput(const char* data, size_t length);
+		bool				hasExpired(time_t now) const;
+
+		/*
+		┌───────────────────────────────────┐
+		│              GETTER               │
+		└───────────────────────────────────┘
+		*/
+		pid_t				getPid() const;
+		int					getStdoutFd() const;
+		int					getStdinFd() const;
+		const std::string&	getOutput() const;
+		bool				getTimedOut() const;
+		unsigned long long	getStartMicros() const;
+		int					getClientFd() const;
+		unsigned long		getClientId() const;
+		const std::string&	getCacheKey() const;
+		bool				getCacheable() const;
+		bool				getCoalesced() const;
+		int					getDefaultTtl() const;
+
+		/*
+		┌───────────────────────────────────┐
+		│              SETTER               │
+		└───────────────────────────────────┘
+		*/
+		void				setTimedOut(bool timedOut);
+		void				setStdinFd(int stdinFd);
+		void				setCaching(const std::string& cacheKey, bool cacheable, bool coalesced, int defaultTtl);
+};
+
+#endif
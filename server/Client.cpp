@@ -11,28 +11,104 @@
 /* ************************************************************************** */
 
 #include "Client.hpp"
+#include "utils.hpp"
+#include <sstream>
+
+unsigned long Client::_nextId = 0;
 
 Client::Client(int clientSocketFd, struct sockaddr_in clientSocketId, int serverPort)
-	: _clientSocketFd(clientSocketFd), _clientSocketId(clientSocketId), _serverPort(serverPort), 
-	  _isRegisteredCookies(false), _requestBuffer(""), _response(""), _bytesSent(0), _state(READING_HEADERS),
-	  _parsed(false), _keepAlive(false), _headersComplete(false), _hasContentLength(false),
-	  _expectedContentLength(0), _receivedContentLength(0), _bodyComplete(false), _cookies()
+	: _id(++_nextId), _requestBuffer(), _response(), _bytesSent(0), _bytesOut(0), _requestStart(0), _expectedContentLength(0), _receivedContentLength(0),
+	  _bodyStream(NULL), _multipart(NULL), _cookies(NULL), _arena(), _clientSocketId(clientSocketId), _clientSocketFd(clientSocketFd),
+	  _serverPort(serverPort), _epollEvents(EPOLLIN), _status(0), _state(READING_HEADERS), _flags(0)
 {
-	inet_ntop(AF_INET, &_clientSocketId.sin_addr, _clientIp, INET_ADDRSTRLEN);
+}
+
+// Outlives every client: built on the first accept, torn down after main
+static ClientPool&	clientPool()
+{
+	static ClientPool pool(sizeof(Client));
+	return (pool);
+}
+
+static BufferPool&	ioBuffers()
+{
+	static BufferPool pool;
+	return (pool);
 }
 
 Client::~Client()
 {
+	delete _multipart;
+	delete _bodyStream;
+	delete _cookies;
+	ioBuffers().giveBack(_requestBuffer);
+	ioBuffers().giveBack(_response);
 	close(_clientSocketFd);
 }
 
+void*	Client::operator new(size_t size)
+{
+	if (size != sizeof(Client))
+		return (::operator new(size));
+	return (clientPool().acquire());
+}
+
+void	Client::operator delete(void* object, size_t size)
+{
+	if (size != sizeof(Client))
+		return (::operator delete(object));
+	clientPool().release(object);
+}
+
+const ClientPool&	Client::getPool()
+{
+	return (clientPool());
+}
+
+bool	Client::hasFlag(Flag flag) const {
+	return ((_flags & flag) != 0);
+}
+
+void	Client::setFlag(Flag flag, bool value) {
+	if (value)
+		_flags |= flag;
+	else
+		_flags &= ~flag;
+}
+
 /*
 ┌───────────────────────────────────┐
 │              METHOD               │
 └───────────────────────────────────┘
 */
-void	Client::appendToRequestBuffer(const char* data) {
-	_requestBuffer.append(data);
+void	Client::appendToRequestBuffer(const char* data, size_t length) {
+	if (_requestBuffer.empty())
+	{
+		ioBuffers().borrow(_requestBuffer);
+		if (_state == READING_HEADERS)
+			_requestStart = monotonicMicros();
+	}
+	_requestBuffer.append(data, length);
+}
+
+void	Client::startMultipart(MultipartParser* parser) {
+	delete _multipart;
+	_multipart = parser;
+}
+
+// The parser goes with the I/O task writing the next body bytes and comes
+// back through startMultipart once they are on disk
+MultipartParser*	Client::takeMultipart() {
+	MultipartParser* parser = _multipart;
+	_multipart = NULL;
+	return (parser);
+}
+
+// Drops body bytes handed to the upload from the buffer, so only the
+// request headers stay in memory
+void	Client::consumeBody(size_t bodyStart, size_t length) {
+	_receivedContentLength += length;
+	_requestBuffer.erase(bodyStart, length);
 }
 
 int	Client::requestBufferContains(const std::string& str, size_t startPos) const {
@@ -40,12 +116,54 @@ int	Client::requestBufferContains(const std::string& str, size_t startPos) const
 	return (pos);
 }
 
+// Replaces the sent response with the next piece of the streamed body
+// (framed as a chunk unless the stream is file-backed); false once the
+// whole body has been queued
+bool	Client::fillResponse() {
+	if (!_bodyStream)
+		return (false);
+	std::string piece;
+	bool more = true;
+	while (piece.empty() && more && !_bodyStream->hasFileRange())
+		more = _bodyStream->read(piece);
+	if (!_bodyStream->isChunked())
+	{
+		if (!more)
+		{
+			delete _bodyStream;
+			_bodyStream = NULL;
+		}
+		setResponse(piece);
+		return (!piece.empty() || more);
+	}
+	std::ostringstream chunk;
+	if (!piece.empty())
+		chunk << std::hex << piece.size() << "\r\n" << piece << "\r\n";
+	if (!more)
+	{
+		chunk << "0\r\n\r\n";
+		delete _bodyStream;
+		_bodyStream = NULL;
+	}
+	setResponse(chunk.str());
+	return (true);
+}
+
+// Sends the next slice of a file range straight from the page cache
+ssize_t	Client::sendFileRange() {
+	return (_bodyStream->sendFile(_clientSocketFd));
+}
+
 /*
 ┌───────────────────────────────────┐
 │              GETTER               │
 └───────────────────────────────────┘
 */
 
+unsigned long						Client::getId() const {
+	return (_id);
+}
+
 int									Client::getClientSocketFd() const {
 	return (_clientSocketFd);
 }
@@ -55,18 +173,19 @@ int									Client::getClientPort() const {
 }
 
 bool								Client::getIsRegisteredCookies() const {
-	return (_isRegisteredCookies);
+	return (hasFlag(REGISTERED_COOKIES));
 }
 
-std::map<std::string, std::string>	Client::getCookies() const {
-	return (_cookies);
+const std::map<std::string, std::string>&	Client::getCookies() const {
+	static const CookieMap none;
+	return (_cookies ? *_cookies : none);
 }
 
 Client::State						Client::getState() const {
-	return (_state);
+	return (static_cast<State>(_state));
 }
 
-std::string							Client::getRequestBuffer() const {
+const std::string&					Client::getRequestBuffer() const {
 	return (_requestBuffer);
 }
 
@@ -74,33 +193,87 @@ size_t								Client::getExpectedContentLength() const {
 	return (_expectedContentLength);
 }
 
+size_t								Client::getReceivedContentLength() const {
+	return (_receivedContentLength);
+}
+
+MultipartParser*					Client::getMultipart() const {
+	return (_multipart);
+}
+
 bool								Client::getHasContentLength() const {
-	return (_hasContentLength);
+	return (hasFlag(HAS_CONTENT_LENGTH));
 }
 
 bool								Client::getKeepAlive() const {
-	return (_keepAlive);
+	return (hasFlag(KEEP_ALIVE));
 }
 
 bool								Client::getParsed() const {
-	return (_parsed);
+	return (hasFlag(PARSED));
+}
+
+bool								Client::getBypassFlight() const {
+	return (hasFlag(BYPASS_FLIGHT));
+}
+
+bool								Client::getWritingUpload() const {
+	return (hasFlag(WRITING_UPLOAD));
 }
 
-std::string							Client::getResponse() const {
+const std::string&					Client::getResponse() const {
 	return (_response);
 }
 
+size_t								Client::getBytesSent() const {
+	return (_bytesSent);
+}
+
+bool								Client::hasBodyStream() const {
+	return (_bodyStream != NULL);
+}
+
+uint32_t							Client::getEpollEvents() const {
+	return (_epollEvents);
+}
+
+Arena&								Client::getArena() {
+	return (_arena);
+}
+
+struct in_addr						Client::getAddress() const {
+	return (_clientSocketId.sin_addr);
+}
+
+int									Client::getStatus() const {
+	return (_status);
+}
+
+size_t								Client::getBytesOut() const {
+	return (_bytesOut);
+}
+
+unsigned long long					Client::getRequestStart() const {
+	return (_requestStart);
+}
+
+bool								Client::hasFileRange() const {
+	return (_bodyStream != NULL && _bodyStream->hasFileRange());
+}
+
 /*
 ┌───────────────────────────────────┐
 │              SETTER               │
 └───────────────────────────────────┘
 */
 void								Client::setRegistered(bool registered) {
-	_isRegisteredCookies = registered;
+	setFlag(REGISTERED_COOKIES, registered);
 }
 
 void								Client::setCookies(std::map<std::string, std::string> cookies) {
-	_cookies = cookies;
+	if (!_cookies)
+		_cookies = new CookieMap();
+	_cookies->swap(cookies);
 }
 
 void								Client::setState(State state) {
@@ -108,7 +281,7 @@ void								Client::setState(State state) {
 }
 
 void								Client::setHeadersComplete(bool complete) {
-	_headersComplete = complete;
+	setFlag(HEADERS_COMPLETE, complete);
 }
 
 void								Client::setExpectedContentLength(size_t length) {
@@ -116,37 +289,71 @@ void								Client::setExpectedContentLength(size_t length) {
 }
 
 void								Client::setHasContentLength(bool hasContentLength) {
-	_hasContentLength = hasContentLength;
+	setFlag(HAS_CONTENT_LENGTH, hasContentLength);
 }
 
 void								Client::setKeepAlive(bool keepAlive) {
-	_keepAlive = keepAlive;
+	setFlag(KEEP_ALIVE, keepAlive);
 }
 
 void								Client::setParsed(bool parsed) {
-	_parsed = parsed;
+	setFlag(PARSED, parsed);
+}
+
+void								Client::setBypassFlight(bool bypass) {
+	setFlag(BYPASS_FLIGHT, bypass);
+}
+
+void								Client::setWritingUpload(bool writing) {
+	setFlag(WRITING_UPLOAD, writing);
 }
 
 void								Client::setBodyComplete(bool complete) {
-	_bodyComplete = complete;
+	setFlag(BODY_COMPLETE, complete);
 }
 
 void								Client::setResponse(const std::string& response) {
+	if (!response.empty() && response.size() <= IO_BUFFER_SIZE)
+		ioBuffers().borrow(_response);
 	_response = response;
+	_bytesSent = 0;
 }
 
 void								Client::setBytesSent(size_t bytes) {
 	_bytesSent = bytes;
 }
 
+void								Client::setEpollEvents(uint32_t events) {
+	_epollEvents = events;
+}
+
+void								Client::setStatus(int status) {
+	_status = status;
+}
+
+void								Client::addBytesOut(size_t bytes) {
+	_bytesOut += bytes;
+}
+
+void								Client::setBodyStream(BodyStream* stream) {
+	delete _bodyStream;
+	_bodyStream = stream;
+}
+
+// The connection goes idle: its buffers return to the shared pool
 void								Client::resetForNewRequest() {
-	_requestBuffer.clear();
-	_response.clear();
+	ioBuffers().giveBack(_requestBuffer);
+	ioBuffers().giveBack(_response);
+	_bytesSent = 0;
+	_bytesOut = 0;
+	_status = 0;
+	delete _bodyStream;
+	_bodyStream = NULL;
 	_state = READING_HEADERS;
-	_parsed = false;
-	_headersComplete = false;
-	_hasContentLength = false;
+	_flags &= REGISTERED_COOKIES | KEEP_ALIVE;
 	_expectedContentLength = 0;
 	_receivedContentLength = 0;
-	_bodyComplete = false;
+	delete _multipart;
+	_multipart = NULL;
+	_arena.reset();
 }
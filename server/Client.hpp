@@ -20,6 +20,13 @@
 #include <iostream>
 #include <map>
 #include <cstdlib>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include "MultipartParser.hpp"
+#include "BodyStream.hpp"
+#include "ClientPool.hpp"
+#include "Arena.hpp"
+#include "BufferPool.hpp"
 
 
 class Client
@@ -31,59 +38,102 @@ class Client
 			READING_BODY,    // 1
 			READY_TO_RESPOND, // 2
 			WRITING_RESPONSE, // 3
-			CLOSING           // 4
+			CLOSING,          // 4
+			WAITING_RESPONSE  // 5 suspended until a CGI or I/O job completes
 		};
 		
 	private:
-		// settings (id)
-		int					_clientSocketFd;
-		struct sockaddr_in	_clientSocketId;
-		char				_clientIp[INET_ADDRSTRLEN];
-		int					_serverPort;
-		bool				_isRegisteredCookies;
+		// Prevent Copying
+		Client(const Client& other);
+		Client&				operator=(const Client& other);
+		// request state flags, packed in _flags
+		enum Flag {
+			REGISTERED_COOKIES = 1 << 0,
+			PARSED = 1 << 1,
+			KEEP_ALIVE = 1 << 2,
+			BYPASS_FLIGHT = 1 << 3,
+			HEADERS_COMPLETE = 1 << 4,
+			HAS_CONTENT_LENGTH = 1 << 5,
+			BODY_COMPLETE = 1 << 6,
+			WRITING_UPLOAD = 1 << 7 // the parser is away with an I/O task
+		};
+		typedef std::map<std::string, std::string>	CookieMap;
+		// members are ordered by size so the object carries no padding
+		static unsigned long	_nextId;
+		unsigned long		_id;
 		// request storage
 		std::string			_requestBuffer;
 		std::string			_response;
 		size_t				_bytesSent;
-		// request info
-		State				_state;
-		bool				_parsed;
-		bool				_keepAlive;
-		// header info
-		bool				_headersComplete;
-		bool				_hasContentLength;
+		size_t				_bytesOut; // whole response so far, for the access log
+		unsigned long long	_requestStart; // monotonic microseconds of the first request byte
 		// body settings
 		size_t				_expectedContentLength;
 		size_t				_receivedContentLength;
-		bool				_bodyComplete;
-		
-		// cookies storage
-		std::map<std::string, std::string> _cookies;
+		BodyStream*			_bodyStream; // rest of a streamed or file-backed response
+		MultipartParser*	_multipart; // set while a multipart upload streams to disk, between writes
+		CookieMap*			_cookies; // created by the first Cookie header
+		Arena				_arena; // temporaries of the request being handled
+		// settings (id)
+		struct sockaddr_in	_clientSocketId;
+		int					_clientSocketFd;
+		int					_serverPort;
+		uint32_t			_epollEvents; // interest set currently registered
+		uint16_t			_status;
+		uint8_t				_state;
+		uint8_t				_flags;
+
+		bool				hasFlag(Flag flag) const;
+		void				setFlag(Flag flag, bool value);
 		
 	public:
 		Client(int clientSocketFd, struct sockaddr_in clientSocketId, int serverPort);
 		~Client();
+		// connection objects come from a slab pool, not the general heap;
+		// any other size goes to the global allocator both ways
+		static void*	operator new(size_t size);
+		static void		operator delete(void* object, size_t size);
+		static const ClientPool&	getPool();
 
-		void	appendToRequestBuffer(const char* data);
+		void	appendToRequestBuffer(const char* data, size_t length);
 		int		requestBufferContains(const std::string& str, size_t startPos) const;
 		void	resetForNewRequest();
+		void	startMultipart(MultipartParser* parser);
+		MultipartParser*	takeMultipart();
+		void	consumeBody(size_t bodyStart, size_t length);
+		bool	fillResponse();
+		ssize_t	sendFileRange();
 
 		/*
 		┌───────────────────────────────────┐
 		│              GETTER               │
 		└───────────────────────────────────┘
 		*/
+		unsigned long	getId() const;
 		int				getClientSocketFd() const;
 		int				getClientPort() const;
 		bool			getIsRegisteredCookies() const;
-		std::map<std::string, std::string> getCookies() const;
+		const std::map<std::string, std::string>&	getCookies() const;
 		State			getState() const;
-		std::string		getRequestBuffer() const;
+		const std::string&	getRequestBuffer() const;
 		size_t			getExpectedContentLength() const;
+		size_t			getReceivedContentLength() const;
+		MultipartParser*	getMultipart() const;
 		bool			getHasContentLength() const;
 		bool			getKeepAlive() const;
 		bool			getParsed() const;
-		std::string		getResponse() const;
+		bool			getBypassFlight() const;
+		bool			getWritingUpload() const;
+		const std::string&	getResponse() const;
+		size_t			getBytesSent() const;
+		bool			hasBodyStream() const;
+		bool			hasFileRange() const;
+		uint32_t		getEpollEvents() const;
+		Arena&			getArena();
+		struct in_addr	getAddress() const;
+		int				getStatus() const;
+		size_t			getBytesOut() const;
+		unsigned long long	getRequestStart() const;
 
 		/*
 		┌───────────────────────────────────┐
@@ -98,9 +148,15 @@ class Client
 		void			setHasContentLength(bool hasContentLength);
 		void			setKeepAlive(bool keepAlive);
 		void			setParsed(bool parsed);
+		void			setBypassFlight(bool bypass);
+		void			setWritingUpload(bool writing);
 		void			setBodyComplete(bool complete);
 		void			setResponse(const std::string& response);
 		void			setBytesSent(size_t bytes);
+		void			setBodyStream(BodyStream* stream);
+		void			setEpollEvents(uint32_t events);
+		void			setStatus(int status);
+		void			addBytesOut(size_t bytes);
 };
 
 #endif
@@ -0,0 +1,68 @@
+#include "ClientPool.hpp"
+#include <new>
+
+// slots keep the alignment malloc would have given the object
+static const size_t SLOT_ALIGN = 2 * sizeof(void *);
+
+ClientPool::ClientPool(size_t objectSize)
+	: _slotSize((objectSize + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN), _free(NULL), _inUse(0)
+{
+}
+
+ClientPool::~ClientPool()
+{
+	for (size_t i = 0; i < _slabs.size(); i++)
+		::operator delete(_slabs[i]);
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+void	ClientPool::grow()
+{
+	char* slab = static_cast<char *>(::operator new(_slotSize * CLIENT_SLAB_OBJECTS));
+	_slabs.push_back(slab);
+	for (size_t i = CLIENT_SLAB_OBJECTS; i > 0; i--)
+	{
+		Slot* slot = reinterpret_cast<Slot *>(slab + (i - 1) * _slotSize);
+		slot->next = _free;
+		_free = slot;
+	}
+}
+
+void*	ClientPool::acquire()
+{
+	if (!_free)
+		grow();
+	Slot* slot = _free;
+	_free = slot->next;
+	_inUse++;
+	return (slot);
+}
+
+void	ClientPool::release(void* object)
+{
+	if (!object)
+		return ;
+	Slot* slot = static_cast<Slot *>(object);
+	slot->next = _free;
+	_free = slot;
+	_inUse--;
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+size_t	ClientPool::inUse() const {
+	return (_inUse);
+}
+
+size_t	ClientPool::capacity() const {
+	return (_slabs.size() * CLIENT_SLAB_OBJECTS);
+}
@@ -0,0 +1,45 @@
+#ifndef CLIENTPOOL_HPP
+#define CLIENTPOOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define CLIENT_SLAB_OBJECTS 256 // connection objects carved from one slab
+
+/*
+*	Fixed-size slab allocator for connection objects. Slabs are never
+*	given back while the server runs: a freed slot goes on an intrusive
+*	free list and the next accept reuses it, so connection churn costs
+*	a pointer swap instead of a malloc/free pair and the heap does not
+*	fragment around long-lived connections.
+*	Only the event loop thread creates and destroys clients, so there is
+*	no locking.
+*/
+class ClientPool
+{
+	private:
+		struct Slot
+		{
+			Slot*	next;
+		};
+		size_t				_slotSize;
+		std::vector<char*>	_slabs;
+		Slot*				_free;
+		size_t				_inUse;
+		// Prevent Copying
+		ClientPool(const ClientPool& other);
+		ClientPool&			operator=(const ClientPool& other);
+
+		void				grow();
+
+	public:
+		explicit ClientPool(size_t objectSize);
+		~ClientPool();
+
+		void*				acquire();
+		void				release(void* object);
+		size_t				inUse() const;
+		size_t				capacity() const;
+};
+
+#endif
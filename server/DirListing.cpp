@@ -0,0 +1,123 @@
+#include "DirListing.hpp"
+#include "uploads.hpp"
+#include "utils.hpp"
+#include <map>
+#include <algorithm>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static std::map<std::string, DirListing *>	g_listings;
+static pthread_mutex_t						g_listingsLock = PTHREAD_MUTEX_INITIALIZER;
+
+DirListing::DirListing(const std::string& version) : _version(version), _refs(1)
+{
+}
+
+DirListing::~DirListing()
+{
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// Cached snapshot if the directory did not change, a fresh one otherwise;
+// NULL if the directory cannot be read. The caller owns one reference.
+DirListing*	DirListing::acquire(const std::string& dir)
+{
+	std::string current = version(dir);
+	if (current.empty())
+		return (NULL);
+	pthread_mutex_lock(&g_listingsLock);
+	std::map<std::string, DirListing *>::iterator it = g_listings.find(dir);
+	if (it != g_listings.end() && it->second->_version == current)
+	{
+		__sync_add_and_fetch(&it->second->_refs, 1);
+		pthread_mutex_unlock(&g_listingsLock);
+		return (it->second);
+	}
+	pthread_mutex_unlock(&g_listingsLock);
+
+	DirListing* listing = new DirListing(current);
+	if (dir == UPLOAD_PATH)
+		uploads::indexNames(listing->_names);
+	else
+	{
+		DIR* handle = opendir(dir.c_str());
+		if (handle == NULL)
+		{
+			delete listing;
+			return (NULL);
+		}
+		struct dirent* entry;
+		while ((entry = readdir(handle)))
+		{
+			if (entry->d_type == DT_REG)
+				listing->_names.push_back(entry->d_name);
+		}
+		closedir(handle);
+		std::sort(listing->_names.begin(), listing->_names.end());
+	}
+
+	pthread_mutex_lock(&g_listingsLock);
+	DirListing*& cached = g_listings[dir];
+	if (cached)
+		cached->release();
+	cached = listing;
+	__sync_add_and_fetch(&listing->_refs, 1);
+	pthread_mutex_unlock(&g_listingsLock);
+	return (listing);
+}
+
+void	DirListing::release()
+{
+	if (__sync_sub_and_fetch(&_refs, 1) == 0)
+		delete this;
+}
+
+// What the cached snapshot is checked against
+std::string	DirListing::version(const std::string& dir)
+{
+	if (dir == UPLOAD_PATH)
+		return ("index " + to_string(uploads::indexGeneration()));
+	struct stat info;
+	if (stat(dir.c_str(), &info) == -1 || !S_ISDIR(info.st_mode))
+		return ("");
+	return (to_string(info.st_ino) + " " + to_string(info.st_mtim.tv_sec) + "." + to_string(info.st_mtim.tv_nsec));
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+const std::vector<std::string>&	DirListing::getNames() const {
+	return (_names);
+}
+
+AutoIndexStream::AutoIndexStream(DirListing* listing, size_t begin, size_t end, const std::string& head, const std::string& tail)
+	: _listing(listing), _next(begin), _end(end), _head(head), _tail(tail)
+{
+}
+
+AutoIndexStream::~AutoIndexStream()
+{
+	_listing->release();
+}
+
+bool	AutoIndexStream::read(std::string& out)
+{
+	out += _head;
+	std::string().swap(_head);
+	const std::vector<std::string>& names = _listing->getNames();
+	for (size_t stop = std::min(_end, _next + AUTOINDEX_SLICE); _next < stop; _next++)
+		out += "<li><a href=\"" + names[_next] + "\" class=\"file_link\">" + names[_next] + "</a></li>";
+	if (_next < _end)
+		return (true);
+	out += _tail;
+	return (false);
+}
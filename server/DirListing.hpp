@@ -0,0 +1,58 @@
+#ifndef DIRLISTING_HPP
+#define DIRLISTING_HPP
+
+#include "BodyStream.hpp"
+#include <string>
+#include <vector>
+
+#define AUTOINDEX_PAGE_SIZE 1000 // entries per ?page= or ?cursor= page
+#define AUTOINDEX_SLICE 256 // entries rendered per chunk of a streamed listing
+
+/*
+*	Sorted file names of a directory, shared between the listing cache and
+*	the responses that render it. A snapshot never changes: when the
+*	directory mtime moves (or, for the upload directory, the upload index
+*	changes) the next acquire() reads a new one and the old one lives on
+*	until its last reader releases it. Used from the I/O pool threads.
+*/
+class DirListing
+{
+	private:
+		std::vector<std::string>	_names;
+		std::string					_version;
+		int							_refs;
+
+		DirListing(const std::string& version);
+		~DirListing();
+		static std::string			version(const std::string& dir);
+		// Prevent Copying
+		DirListing(const DirListing& other);
+		DirListing&					operator=(const DirListing& other);
+
+	public:
+		static DirListing*				acquire(const std::string& dir);
+		void							release();
+		const std::vector<std::string>&	getNames() const;
+};
+
+// Renders entries [begin, end) of a listing between head and tail
+class AutoIndexStream : public BodyStream
+{
+	private:
+		DirListing*		_listing;
+		size_t			_next;
+		size_t			_end;
+		std::string		_head;
+		std::string		_tail;
+		// Prevent Copying
+		AutoIndexStream(const AutoIndexStream& other);
+		AutoIndexStream&	operator=(const AutoIndexStream& other);
+
+	public:
+		AutoIndexStream(DirListing* listing, size_t begin, size_t end, const std::string& head, const std::string& tail);
+		~AutoIndexStream();
+
+		bool			read(std::string& out);
+};
+
+#endif
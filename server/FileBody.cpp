@@ -0,0 +1,87 @@
+#include "FileBody.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+
+FileBody::FileBody(int fd) : _fd(fd), _current(0)
+{
+}
+
+FileBody::~FileBody()
+{
+	close(_fd);
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+void	FileBody::addText(const std::string& text)
+{
+	Part part;
+	part.text = text;
+	part.offset = 0;
+	part.length = 0;
+	_parts.push_back(part);
+}
+
+void	FileBody::addRange(off_t offset, off_t length)
+{
+	Part part;
+	part.offset = offset;
+	part.length = length;
+	if (length > 0)
+		_parts.push_back(part);
+}
+
+bool	FileBody::empty() const
+{
+	return (_current == _parts.size());
+}
+
+// Text up to the next file range
+bool	FileBody::read(std::string& out)
+{
+	while (!empty() && _parts[_current].length == 0)
+	{
+		out += _parts[_current].text;
+		_current++;
+	}
+	return (!empty());
+}
+
+bool	FileBody::isChunked() const
+{
+	return (false);
+}
+
+bool	FileBody::hasFileRange() const
+{
+	return (!empty() && _parts[_current].length > 0);
+}
+
+ssize_t	FileBody::sendFile(int socketFd)
+{
+	Part& part = _parts[_current];
+	size_t count = part.length < SENDFILE_MAX ? part.length : SENDFILE_MAX;
+	ssize_t sent = sendfile(socketFd, _fd, &part.offset, count);
+	if (sent > 0)
+	{
+		part.length -= sent;
+		if (part.length == 0)
+			_current++;
+	}
+	return (sent);
+}
+
+BodyStream*	FileBody::share() const
+{
+	int fd = fcntl(_fd, F_DUPFD_CLOEXEC, 0);
+	if (fd == -1)
+		return (NULL);
+	FileBody* copy = new FileBody(fd);
+	copy->_parts.assign(_parts.begin() + _current, _parts.end());
+	return (copy);
+}
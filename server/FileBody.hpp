@@ -0,0 +1,49 @@
+#ifndef FILEBODY_HPP
+#define FILEBODY_HPP
+
+#include "BodyStream.hpp"
+#include <vector>
+
+#define SENDFILE_MAX 1048576 // bytes handed to one sendfile call
+
+/*
+*	A static file body: byte ranges of an open file, possibly separated
+*	by text (the part headers of a multipart/byteranges response). Ranges
+*	go from the page cache to the socket with sendfile, so serving a slice
+*	of a large file costs only the bytes requested. Owns the file fd;
+*	a shared copy gets a duplicate of it, and since sendfile is given the
+*	offset each copy reads the file independently.
+*/
+class FileBody : public BodyStream
+{
+	private:
+		struct Part
+		{
+			std::string	text;
+			off_t		offset;
+			off_t		length; // 0 for a text part
+		};
+		int					_fd;
+		std::vector<Part>	_parts;
+		size_t				_current; // parts before it are sent
+		// Prevent Copying
+		FileBody(const FileBody& other);
+		FileBody&			operator=(const FileBody& other);
+
+	public:
+		FileBody(int fd);
+		~FileBody();
+
+		void				addText(const std::string& text);
+		void				addRange(off_t offset, off_t length);
+
+		bool				empty() const;
+
+		bool				read(std::string& out);
+		bool				isChunked() const;
+		bool				hasFileRange() const;
+		ssize_t				sendFile(int socketFd);
+		BodyStream*			share() const;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "FsTask.hpp"
+#include "Server.hpp"
+#include "MultipartParser.hpp"
+
+FsTask*	FsTask::_spare = NULL;
+size_t	FsTask::_spareCount = 0;
+
+FsTask::FsTask(Server& server, const Client* client)
+	: IoTask(&server, client), _op(READ_PAGE), _isRegistered(false), _bodyLimit(0), _location(NULL), _upload(NULL), _nextSpare(NULL)
+{
+}
+
+FsTask::~FsTask()
+{
+	delete _upload;
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+FsTask*	FsTask::create(Op op, Server& server, const Client* client, const char* target, size_t length, const LocationConfig* location)
+{
+	FsTask* task;
+	if (_spare)
+	{
+		task = _spare;
+		_spare = task->_nextSpare;
+		_spareCount--;
+		task->reset(&server, client);
+	}
+	else
+		task = new FsTask(server, client);
+	task->init(op, server, client, target, length, location);
+	return (task);
+}
+
+FsTask*	FsTask::create(Op op, Server& server, const Client* client, const std::string& target, const LocationConfig* location)
+{
+	return (create(op, server, client, target.data(), target.size(), location));
+}
+
+void	FsTask::release()
+{
+	delete _upload;
+	_upload = NULL;
+	if (_spareCount == FSTASK_SPARE_MAX
+		|| _target.capacity() + _headers.capacity() + getResponse().capacity() > FSTASK_SPARE_BYTES)
+	{
+		delete this;
+		return ;
+	}
+	_nextSpare = _spare;
+	_spare = this;
+	_spareCount++;
+}
+
+void	FsTask::releaseSpare()
+{
+	while (_spare)
+	{
+		FsTask* next = _spare->_nextSpare;
+		delete _spare;
+		_spare = next;
+	}
+	_spareCount = 0;
+}
+
+// Everything is assigned in place: a reused task allocates nothing
+void	FsTask::init(Op op, Server& server, const Client* client, const char* target, size_t length, const LocationConfig* location)
+{
+	_op = op;
+	_target.assign(target, length);
+	_headers.clear();
+	_contentType.clear();
+	_isRegistered = client->getIsRegisteredCookies();
+	_bodyLimit = server.getClientBodyLimit();
+	_location = location;
+	// identical page reads share one trip to the disk; the key holds every
+	// header that can change a static response
+	if (op != READ_PAGE && op != METHODS_PAGE)
+		return ;
+	std::string& key = flightKey();
+	key = static_cast<char>('0' + op);
+	key += _isRegistered ? " 1 " : " 0 ";
+	key += _target;
+	if (op == READ_PAGE)
+	{
+		const std::string& request = client->getRequestBuffer();
+		_headers.assign(request, 0, request.find("\r\n\r\n") + 4);
+		_contentType = server.getMimeTypes().lookup(_target);
+		appendHeader(key, "If-None-Match");
+		appendHeader(key, "If-Modified-Since");
+		appendHeader(key, "Range");
+		appendHeader(key, "If-Range");
+		if (gzipStatic())
+			appendHeader(key, "Accept-Encoding");
+		else
+			key += '\n';
+	}
+}
+
+void	FsTask::setUpload(MultipartParser* parser)
+{
+	_upload = parser;
+}
+
+MultipartParser*	FsTask::takeUpload()
+{
+	if (_op != WRITE_UPLOAD)
+		return (NULL);
+	MultipartParser* parser = _upload;
+	_upload = NULL;
+	return (parser);
+}
+
+void	FsTask::appendHeader(std::string& key, const char* name) const
+{
+	size_t length;
+	const char* value = findHeaderValue(_headers, name, length);
+	key += '\n';
+	if (value)
+		key.append(value, length);
+}
+
+bool	FsTask::gzipStatic() const
+{
+	return (_location && _location->getLocationGzipStatic());
+}
+
+void	FsTask::execute(std::string& response)
+{
+	switch (_op)
+	{
+		case READ_PAGE:
+		{
+			BodyStream* stream = NULL;
+			uploads::locate(_target);
+			method::foundPage(_target, _contentType, _isRegistered, _headers, stream, gzipStatic(), response);
+			setStream(stream);
+			return ;
+		}
+		case METHODS_PAGE:
+			response = method::generateMethodsPage(_isRegistered, _target);
+			return ;
+		case AUTOINDEX:
+		{
+			BodyStream* stream = NULL;
+			response = method::generateAutoIndexPage(_location, _isRegistered, _target, stream);
+			setStream(stream);
+			return ;
+		}
+		case WRITE_TERMINAL:
+			response = method::postFromTerminal(_target, _bodyLimit);
+			return ;
+		case WRITE_DASHBOARD:
+			response = method::postFromDashboard(_target, _bodyLimit);
+			return ;
+		case DELETE_FORM:
+			response = method::handleDeleteRequest(_target);
+			return ;
+		case REMOVE_FILE:
+			uploads::locate(_target);
+			response = method::removeFile(_target);
+			return ;
+		case WRITE_UPLOAD:
+			_upload->feed(_target.data(), _target.size());
+			return ;
+		case FINISH_UPLOAD:
+			response = method::finishUpload(*_upload, _target);
+			return ;
+	}
+	throw std::runtime_error(ERROR_500_RESPONSE);
+}
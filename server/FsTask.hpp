@@ -0,0 +1,73 @@
+#ifndef FSTASK_HPP
+#define FSTASK_HPP
+
+#include "IoPool.hpp"
+#include <sys/types.h>
+
+#define FSTASK_SPARE_MAX 64 // finished tasks kept for the next requests
+#define FSTASK_SPARE_BYTES 16384 // a task holding more than this is freed
+
+class LocationConfig;
+
+/*
+*	The filesystem side of a request handler, run on the I/O pool.
+*	target is the file path for READ_PAGE and REMOVE_FILE, the listing
+*	cursor for METHODS_PAGE, the request target (with its query) for
+*	AUTOINDEX, the raw request for the upload and delete-form jobs, the
+*	body bytes for the multipart ones. A multipart task holds the client's
+*	parser while it runs; a client has one at a time, so parts are written
+*	in order.
+*	Tasks come from create() and go back with release(): a finished task
+*	waits on a spare list and is reset for the next request, so in steady
+*	state its strings already have the room they need. Both ends run on
+*	the event loop thread.
+*/
+class FsTask : public IoTask
+{
+	public:
+		enum Op {
+			READ_PAGE,
+			METHODS_PAGE,
+			AUTOINDEX,
+			WRITE_TERMINAL,
+			WRITE_DASHBOARD,
+			DELETE_FORM,
+			REMOVE_FILE,
+			WRITE_UPLOAD, // more multipart body to come
+			FINISH_UPLOAD // the end of the body, answered with 201
+		};
+
+	private:
+		Op						_op;
+		std::string				_target;
+		std::string				_headers; // request headers of a static page
+		std::string				_contentType; // media type of a static page
+		bool					_isRegistered;
+		ssize_t					_bodyLimit;
+		const LocationConfig*	_location;
+		MultipartParser*		_upload;
+		FsTask*					_nextSpare;
+
+		static FsTask*			_spare;
+		static size_t			_spareCount;
+
+		FsTask(Server& server, const Client* client);
+		void					init(Op op, Server& server, const Client* client, const char* target, size_t length, const LocationConfig* location);
+		void					appendHeader(std::string& key, const char* name) const;
+		bool					gzipStatic() const;
+
+	protected:
+		void					execute(std::string& response);
+
+	public:
+		~FsTask();
+
+		static FsTask*			create(Op op, Server& server, const Client* client, const char* target, size_t length, const LocationConfig* location = NULL);
+		static FsTask*			create(Op op, Server& server, const Client* client, const std::string& target, const LocationConfig* location = NULL);
+		void					release();
+		static void				releaseSpare();
+		void					setUpload(MultipartParser* parser);
+		MultipartParser*		takeUpload();
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "Gzip.hpp"
+
+GzipPool::GzipPool()
+{
+}
+
+GzipPool::~GzipPool()
+{
+	for (std::map<int, std::vector<z_stream *> >::iterator it = _idle.begin(); it != _idle.end(); ++it)
+	{
+		for (size_t i = 0; i < it->second.size(); i++)
+		{
+			deflateEnd(it->second[i]);
+			delete it->second[i];
+		}
+	}
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// NULL when zlib cannot set up a context; the response then goes out as is
+z_stream*	GzipPool::acquire(int level)
+{
+	std::vector<z_stream *>& idle = _idle[level];
+	if (!idle.empty())
+	{
+		z_stream* stream = idle.back();
+		idle.pop_back();
+		return (stream);
+	}
+	z_stream* stream = new z_stream();
+	if (deflateInit2(stream, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		delete stream;
+		return (NULL);
+	}
+	return (stream);
+}
+
+void	GzipPool::release(z_stream* stream, int level)
+{
+	std::vector<z_stream *>& idle = _idle[level];
+	if (idle.size() >= GZIP_POOL_MAX || deflateReset(stream) != Z_OK)
+	{
+		deflateEnd(stream);
+		delete stream;
+		return ;
+	}
+	idle.push_back(stream);
+}
+
+GzipStream::GzipStream(BodyStream* body, GzipPool& pool, int level, z_stream* stream)
+	: _body(body), _pool(pool), _level(level), _stream(stream)
+{
+}
+
+GzipStream::~GzipStream()
+{
+	delete _body;
+	if (_stream)
+		_pool.release(_stream, _level);
+}
+
+// A failed deflate cuts the body short, the client sees a truncated stream
+bool	GzipStream::read(std::string& out)
+{
+	std::string piece;
+	bool more = _body->read(piece);
+	if (!gzip::deflateInto(_stream, piece.data(), piece.size(), more ? Z_NO_FLUSH : Z_FINISH, out))
+		more = false;
+	if (!more)
+	{
+		_pool.release(_stream, _level);
+		_stream = NULL;
+	}
+	return (more);
+}
+
+// Appends what deflate produces for data; Z_FINISH also ends the gzip member
+bool	gzip::deflateInto(z_stream* stream, const char* data, size_t length, int flush, std::string& out)
+{
+	char buffer[16384];
+	int status;
+	stream->next_in = (Bytef *)data;
+	stream->avail_in = length;
+	do {
+		stream->next_out = (Bytef *)buffer;
+		stream->avail_out = sizeof(buffer);
+		status = deflate(stream, flush);
+		if (status == Z_STREAM_ERROR)
+			return (false);
+		out.append(buffer, sizeof(buffer) - stream->avail_out);
+	} while (stream->avail_out == 0);
+	return (flush != Z_FINISH || status == Z_STREAM_END);
+}
+
+bool	gzip::compress(GzipPool& pool, int level, const std::string& in, std::string& out)
+{
+	z_stream* stream = pool.acquire(level);
+	if (!stream)
+		return (false);
+	bool done = deflateInto(stream, in.data(), in.size(), Z_FINISH, out);
+	pool.release(stream, level);
+	return (done);
+}
@@ -0,0 +1,63 @@
+#ifndef GZIP_HPP
+#define GZIP_HPP
+
+#include <zlib.h>
+#include <map>
+#include <vector>
+#include <string>
+#include "BodyStream.hpp"
+
+#define GZIP_WINDOW_BITS (15 + 16) // zlib writes the gzip header and trailer
+#define GZIP_POOL_MAX 16 // idle contexts kept per compression level
+
+/*
+*	Deflate contexts kept for reuse. Setting one up allocates a few hundred
+*	KB of zlib state, so the event loop borrows a reset context for each
+*	compressed response and gives it back when the body is done. Only the
+*	event loop thread touches the pool.
+*/
+class GzipPool
+{
+	private:
+		std::map<int, std::vector<z_stream *> >	_idle; // by level
+		// Prevent Copying
+		GzipPool(const GzipPool& other);
+		GzipPool&	operator=(const GzipPool& other);
+
+	public:
+		GzipPool();
+		~GzipPool();
+
+		z_stream*	acquire(int level);
+		void		release(z_stream* stream, int level);
+};
+
+/*
+*	Compresses a streamed body on the fly; each piece read from the wrapped
+*	stream is deflated into the chunk that goes out next.
+*/
+class GzipStream : public BodyStream
+{
+	private:
+		BodyStream*	_body;
+		GzipPool&	_pool;
+		int			_level;
+		z_stream*	_stream;
+		// Prevent Copying
+		GzipStream(const GzipStream& other);
+		GzipStream&	operator=(const GzipStream& other);
+
+	public:
+		GzipStream(BodyStream* body, GzipPool& pool, int level, z_stream* stream);
+		~GzipStream();
+
+		bool		read(std::string& out);
+};
+
+namespace gzip
+{
+	bool	deflateInto(z_stream* stream, const char* data, size_t length, int flush, std::string& out);
+	bool	compress(GzipPool& pool, int level, const std::string& in, std::string& out);
+}
+
+#endif
@@ -0,0 +1,260 @@
+#include "IoPool.hpp"
+#include "Server.hpp"
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdexcept>
+
+IoTask::IoTask(Server* server, const Client* client)
+	: _next(NULL), _server(server), _clientFd(client->getClientSocketFd()), _clientId(client->getId()), _stream(NULL)
+{
+}
+
+IoTask::~IoTask()
+{
+	delete _stream;
+}
+
+// Makes a finished task new again for another client; the strings keep
+// their capacity
+void	IoTask::reset(Server* server, const Client* client)
+{
+	_next = NULL;
+	_server = server;
+	_clientFd = client->getClientSocketFd();
+	_clientId = client->getId();
+	_flightKey.clear();
+	_response.clear();
+	_error.clear();
+	setStream(NULL);
+}
+
+// Event loop side, once the task has been handed back
+void	IoTask::release()
+{
+	delete this;
+}
+
+MultipartParser*	IoTask::takeUpload()
+{
+	return (NULL);
+}
+
+// Worker side: the error responses thrown by method:: are kept as is; the
+// run time goes to this worker's metrics shard
+void	IoTask::run()
+{
+	ALLOC_PHASE(HANDLE);
+	unsigned long long start = monotonicMicros();
+	try {
+		execute(_response);
+	} catch (const std::runtime_error& e) {
+		_error = e.what();
+	} catch (const std::exception& e) {
+		_error = ERROR_500_RESPONSE;
+	}
+	_server->getMetrics().local().ioTasks.observe(monotonicMicros() - start);
+}
+
+Server*				IoTask::getServer() const {
+	return (_server);
+}
+
+int					IoTask::getClientFd() const {
+	return (_clientFd);
+}
+
+unsigned long		IoTask::getClientId() const {
+	return (_clientId);
+}
+
+const std::string&	IoTask::getFlightKey() const {
+	return (_flightKey);
+}
+
+const std::string&	IoTask::getResponse() const {
+	return (_response);
+}
+
+const std::string&	IoTask::getError() const {
+	return (_error);
+}
+
+BodyStream*			IoTask::takeStream() {
+	BodyStream* stream = _stream;
+	_stream = NULL;
+	return (stream);
+}
+
+std::string&		IoTask::flightKey() {
+	return (_flightKey);
+}
+
+void				IoTask::setFlightKey(const std::string& flightKey) {
+	_flightKey = flightKey;
+}
+
+void				IoTask::setStream(BodyStream* stream) {
+	delete _stream;
+	_stream = stream;
+}
+
+IoPool::IoPool() : _stopping(false), _completed(NULL), _eventFd(-1)
+{
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_wakeUp, NULL);
+}
+
+IoPool::~IoPool()
+{
+	stop();
+	pthread_cond_destroy(&_wakeUp);
+	pthread_mutex_destroy(&_lock);
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+void	IoPool::start(int epollFd, size_t threads)
+{
+	_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_eventFd == -1)
+		throw std::runtime_error("Failed to create the I/O pool eventfd");
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.fd = _eventFd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, _eventFd, &event) == -1)
+		throw std::runtime_error("Failed to watch the I/O pool eventfd");
+	// signals stay with the event loop thread
+	sigset_t all, previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	for (size_t i = 0; i < threads; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, workerMain, this) != 0)
+			break ;
+		_threads.push_back(thread);
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (_threads.empty())
+		throw std::runtime_error("Failed to start the I/O pool threads");
+}
+
+// Waits for running jobs; jobs nobody will pick up are dropped
+void	IoPool::stop()
+{
+	pthread_mutex_lock(&_lock);
+	_stopping = true;
+	pthread_cond_broadcast(&_wakeUp);
+	pthread_mutex_unlock(&_lock);
+	for (size_t i = 0; i < _threads.size(); i++)
+		pthread_join(_threads[i], NULL);
+	_threads.clear();
+	for (size_t i = 0; i < _pending.size(); i++)
+		delete _pending[i];
+	_pending.clear();
+	for (IoTask* task = takeCompleted(); task != NULL;)
+	{
+		IoTask* next = task->_next;
+		delete task;
+		task = next;
+	}
+	if (_eventFd != -1)
+		close(_eventFd);
+	_eventFd = -1;
+}
+
+void	IoPool::submit(IoTask* task)
+{
+	pthread_mutex_lock(&_lock);
+	_pending.push_back(task);
+	pthread_cond_signal(&_wakeUp);
+	pthread_mutex_unlock(&_lock);
+}
+
+// Event loop side: hands every finished job back to its server, oldest first
+void	IoPool::drain()
+{
+	uint64_t count;
+	if (read(_eventFd, &count, sizeof(count)) == -1)
+		return ;
+	IoTask* reversed = takeCompleted();
+	IoTask* task = NULL;
+	while (reversed)
+	{
+		IoTask* next = reversed->_next;
+		reversed->_next = task;
+		task = reversed;
+		reversed = next;
+	}
+	while (task)
+	{
+		IoTask* next = task->_next;
+		task->getServer()->finishIo(task);
+		task = next;
+	}
+}
+
+void*	IoPool::workerMain(void* pool)
+{
+	static_cast<IoPool *>(pool)->work();
+	return (NULL);
+}
+
+void	IoPool::work()
+{
+	while (true)
+	{
+		pthread_mutex_lock(&_lock);
+		while (_pending.empty() && !_stopping)
+			pthread_cond_wait(&_wakeUp, &_lock);
+		if (_stopping)
+		{
+			pthread_mutex_unlock(&_lock);
+			return ;
+		}
+		IoTask* task = _pending.front();
+		_pending.pop_front();
+		pthread_mutex_unlock(&_lock);
+		task->run();
+		pushCompleted(task);
+	}
+}
+
+// Treiber stack push: any worker may complete a job at the same time
+void	IoPool::pushCompleted(IoTask* task)
+{
+	IoTask* head;
+	do {
+		head = _completed;
+		task->_next = head;
+	} while (!__sync_bool_compare_and_swap(&_completed, head, task));
+	uint64_t one = 1;
+	if (write(_eventFd, &one, sizeof(one)) == -1)
+		return ; // counter saturated, the loop is already woken up
+}
+
+// The single consumer takes the whole stack at once, so there is no ABA
+IoTask*	IoPool::takeCompleted()
+{
+	IoTask* head;
+	do {
+		head = _completed;
+	} while (!__sync_bool_compare_and_swap(&_completed, head, (IoTask *)NULL));
+	return (head);
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+int		IoPool::getEventFd() const {
+	return (_eventFd);
+}
@@ -0,0 +1,102 @@
+#ifndef IOPOOL_HPP
+#define IOPOOL_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include "BodyStream.hpp"
+
+#define IO_POOL_THREADS 4 // workers running blocking filesystem calls
+
+class Server;
+class Client;
+class MultipartParser;
+
+/*
+*	A blocking job run by the I/O pool. execute() runs on a worker thread
+*	and must not touch server or client state: it only writes a response
+*	(or the error response it threw), possibly followed by a streamed body,
+*	which the event loop later hands to the suspended client through
+*	Server::finishIo. A task writing part of an upload body has no
+*	response: takeUpload() returns the parser it was fed to, and the
+*	client goes on reading the body.
+*/
+class IoTask
+{
+	private:
+		IoTask*			_next; // completion queue link
+		Server*			_server;
+		int				_clientFd;
+		unsigned long	_clientId;
+		std::string		_flightKey;
+		std::string		_response;
+		std::string		_error;
+		BodyStream*		_stream;
+		// Prevent Copying
+		IoTask(const IoTask& other);
+		IoTask&			operator=(const IoTask& other);
+
+	protected:
+		virtual void		execute(std::string& response) = 0;
+		void				reset(Server* server, const Client* client);
+		std::string&		flightKey();
+
+	public:
+		IoTask(Server* server, const Client* client);
+		virtual ~IoTask();
+
+		void				run();
+		virtual void		release();
+		virtual MultipartParser*	takeUpload();
+
+		Server*				getServer() const;
+		int					getClientFd() const;
+		unsigned long		getClientId() const;
+		const std::string&	getFlightKey() const;
+		const std::string&	getResponse() const;
+		const std::string&	getError() const;
+		BodyStream*			takeStream();
+		void				setFlightKey(const std::string& flightKey);
+		void				setStream(BodyStream* stream);
+
+		friend class IoPool;
+};
+
+/*
+*	Small thread pool for filesystem calls that can stall the event loop.
+*	Jobs are handed to the workers under a mutex; finished jobs come back
+*	through a lock-free multi-producer stack and an eventfd that sits in
+*	the shared epoll set, so the loop drains them like any other event.
+*/
+class IoPool
+{
+	private:
+		std::vector<pthread_t>	_threads;
+		pthread_mutex_t			_lock;
+		pthread_cond_t			_wakeUp;
+		std::deque<IoTask *>	_pending;
+		bool					_stopping;
+		IoTask* volatile		_completed;
+		int						_eventFd;
+
+		static void*			workerMain(void* pool);
+		void					work();
+		void					pushCompleted(IoTask* task);
+		IoTask*					takeCompleted();
+		// Prevent Copying
+		IoPool(const IoPool& other);
+		IoPool&					operator=(const IoPool& other);
+
+	public:
+		IoPool();
+		~IoPool();
+
+		void					start(int epollFd, size_t threads);
+		void					stop();
+		void					submit(IoTask* task);
+		void					drain();
+		int						getEventFd() const;
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "Metrics.hpp"
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+static const int trackedStatuses[] = {
+	200, 201, 204, 206, 301, 302, 303, 304, 307, 308,
+	400, 403, 404, 405, 408, 411, 413, 414, 415, 416, 431,
+	500, 501, 502, 503, 504, 505
+};
+static const size_t trackedCount = sizeof(trackedStatuses) / sizeof(trackedStatuses[0]);
+static const char* const methodNames[METRICS_METHODS] = { "GET", "POST", "DELETE", "other" };
+static const char* const cacheNames[METRICS_CACHES] = { "cgi", "flight" };
+
+// Each thread finds its shard here; there is a single Metrics per process
+static __thread MetricsShard*	threadShard = NULL;
+
+void	MetricsHistogram::observe(unsigned long long micros)
+{
+	int bucket = 0;
+	if (micros > 16)
+		bucket = 64 - __builtin_clzll(micros - 1) - 4;
+	if (bucket > METRICS_BUCKETS)
+		bucket = METRICS_BUCKETS;
+	buckets[bucket]++;
+	sum += micros;
+}
+
+Metrics::Metrics()
+{
+	pthread_mutex_init(&_lock, NULL);
+}
+
+Metrics::~Metrics()
+{
+	for (size_t i = 0; i < _shards.size(); i++)
+		std::free(_shards[i]);
+	pthread_mutex_destroy(&_lock);
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+static std::string	quote(const std::string& value)
+{
+	std::string quoted = "\"";
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		if (value[i] == '"' || value[i] == '\\')
+			quoted += '\\';
+		quoted += value[i];
+	}
+	return (quoted + "\"");
+}
+
+// Virtual hosts share ports and unnamed servers share a host, so the
+// label set is the name and every port it listens on
+int		Metrics::addServer(const std::string& name, const std::vector<int>& ports)
+{
+	std::string portList;
+	for (size_t i = 0; i < ports.size(); i++)
+	{
+		char port[16];
+		std::snprintf(port, sizeof(port), i ? ",%d" : "%d", ports[i]);
+		portList += port;
+	}
+	std::string labels = "server=" + quote(name) + ",port=" + quote(portList);
+	for (size_t v = 0; v < _servers.size(); v++)
+	{
+		if (_servers[v] == labels)
+			return (v);
+	}
+	if (_servers.size() == METRICS_SERVERS)
+	{
+		_servers.back() = "server=\"other\",port=\"\"";
+		return (METRICS_SERVERS - 1);
+	}
+	_servers.push_back(labels);
+	return (_servers.size() - 1);
+}
+
+int		Metrics::addRoute(int server, const std::string& location)
+{
+	for (size_t r = 0; r < _routes.size(); r++)
+	{
+		if (_routes[r].server == server && _routes[r].location == location)
+			return (r);
+	}
+	if (_routes.size() == METRICS_ROUTES)
+	{
+		_routes.back().server = -1;
+		_routes.back().location = "other";
+		return (METRICS_ROUTES - 1);
+	}
+	Route route;
+	route.server = server;
+	route.location = location;
+	_routes.push_back(route);
+	return (_routes.size() - 1);
+}
+
+MetricsShard&	Metrics::local()
+{
+	if (threadShard)
+		return (*threadShard);
+	MetricsShard* shard = static_cast<MetricsShard *>(std::calloc(1, sizeof(MetricsShard)));
+	if (!shard)
+		throw std::bad_alloc();
+	pthread_mutex_lock(&_lock);
+	_shards.push_back(shard);
+	pthread_mutex_unlock(&_lock);
+	threadShard = shard;
+	return (*shard);
+}
+
+int		Metrics::methodSlot(const char* method, size_t length)
+{
+	for (int i = 0; i < METRICS_OTHER; i++)
+	{
+		if (std::strlen(methodNames[i]) == length && std::memcmp(methodNames[i], method, length) == 0)
+			return (i);
+	}
+	return (METRICS_OTHER);
+}
+
+int		Metrics::statusSlot(int status)
+{
+	for (size_t i = 0; i < trackedCount; i++)
+	{
+		if (trackedStatuses[i] == status)
+			return (i);
+	}
+	return (METRICS_STATUSES - 1);
+}
+
+/*
+┌───────────────────────────────────┐
+│              RENDER               │
+└───────────────────────────────────┘
+*/
+
+static void	addHistogram(MetricsHistogram& total, const MetricsHistogram& shard)
+{
+	for (int i = 0; i <= METRICS_BUCKETS; i++)
+		total.buckets[i] += shard.buckets[i];
+	total.sum += shard.sum;
+}
+
+void	Metrics::sum(MetricsShard& total) const
+{
+	pthread_mutex_lock(const_cast<pthread_mutex_t *>(&_lock));
+	for (size_t s = 0; s < _shards.size(); s++)
+	{
+		const MetricsShard& shard = *_shards[s];
+		for (int r = 0; r < METRICS_ROUTES; r++)
+		{
+			for (int m = 0; m < METRICS_METHODS; m++)
+				for (int c = 0; c < METRICS_STATUSES; c++)
+					total.requests[r][m][c] += shard.requests[r][m][c];
+			addHistogram(total.latency[r], shard.latency[r]);
+		}
+		for (int v = 0; v < METRICS_SERVERS; v++)
+		{
+			total.connections[v] += shard.connections[v];
+			total.bytesIn[v] += shard.bytesIn[v];
+			total.bytesOut[v] += shard.bytesOut[v];
+			for (int k = 0; k < METRICS_CACHES; k++)
+			{
+				total.cacheHits[v][k] += shard.cacheHits[v][k];
+				total.cacheMisses[v][k] += shard.cacheMisses[v][k];
+			}
+			total.cgiSpawns[v] += shard.cgiSpawns[v];
+			total.cgiFailures[v] += shard.cgiFailures[v];
+			addHistogram(total.cgiDuration[v], shard.cgiDuration[v]);
+		}
+		addHistogram(total.ioTasks, shard.ioTasks);
+	}
+	pthread_mutex_unlock(const_cast<pthread_mutex_t *>(&_lock));
+}
+
+static void	header(std::string& out, const char* name, const char* type, const char* help)
+{
+	out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+}
+
+static void	sample(std::string& out, const char* name, const std::string& labels, const char* number)
+{
+	out += name;
+	if (!labels.empty())
+		out += "{" + labels + "}";
+	out += std::string(" ") + number + "\n";
+}
+
+static void	sample(std::string& out, const char* name, const std::string& labels, unsigned long long value)
+{
+	char number[32];
+	std::snprintf(number, sizeof(number), "%llu", value);
+	sample(out, name, labels, number);
+}
+
+static void	sample(std::string& out, const char* name, const std::string& labels, double value)
+{
+	char number[32];
+	std::snprintf(number, sizeof(number), "%.9g", value);
+	sample(out, name, labels, number);
+}
+
+static void	histogram(std::string& out, const char* name, const std::string& labels, const MetricsHistogram& h)
+{
+	std::string prefix = labels.empty() ? "" : labels + ",";
+	std::string bucket = std::string(name) + "_bucket";
+	unsigned long long count = 0;
+	for (int i = 0; i <= METRICS_BUCKETS; i++)
+	{
+		count += h.buckets[i];
+		char bound[32];
+		if (i == METRICS_BUCKETS)
+			std::strcpy(bound, "+Inf");
+		else
+			std::snprintf(bound, sizeof(bound), "%.9g", (1ULL << (i + 4)) / 1e6);
+		sample(out, bucket.c_str(), prefix + "le=\"" + bound + "\"", count);
+	}
+	sample(out, (std::string(name) + "_sum").c_str(), labels, h.sum / 1e6);
+	sample(out, (std::string(name) + "_count").c_str(), labels, count);
+}
+
+static unsigned long long	histogramCount(const MetricsHistogram& h)
+{
+	unsigned long long count = 0;
+	for (int i = 0; i <= METRICS_BUCKETS; i++)
+		count += h.buckets[i];
+	return (count);
+}
+
+// Text exposition format 0.0.4; series that never moved are left out
+std::string	Metrics::render(const std::vector<size_t>& active, const std::vector<size_t>& idle) const
+{
+	MetricsShard* total = static_cast<MetricsShard *>(std::calloc(1, sizeof(MetricsShard)));
+	if (!total)
+		throw std::bad_alloc();
+	sum(*total);
+	const std::vector<std::string>& server = _servers;
+	std::vector<std::string> route;
+	for (size_t r = 0; r < _routes.size(); r++)
+	{
+		const std::string& owner = _routes[r].server < 0 ? "server=\"other\",port=\"\"" : server[_routes[r].server];
+		route.push_back(owner + ",location=" + quote(_routes[r].location));
+	}
+	std::string out;
+
+	header(out, "webserv_requests_total", "counter", "Requests answered, by server, location, method and status.");
+	for (size_t r = 0; r < _routes.size(); r++)
+		for (int m = 0; m < METRICS_METHODS; m++)
+			for (int c = 0; c < METRICS_STATUSES; c++)
+			{
+				if (total->requests[r][m][c] == 0)
+					continue ;
+				char status[8];
+				if (c < static_cast<int>(trackedCount))
+					std::snprintf(status, sizeof(status), "%d", trackedStatuses[c]);
+				else
+					std::strcpy(status, "other");
+				sample(out, "webserv_requests_total", route[r] + ",method=\"" + methodNames[m]
+					+ "\",status=\"" + status + "\"", total->requests[r][m][c]);
+			}
+	header(out, "webserv_request_duration_seconds", "histogram", "Time from the first byte of a request to its last byte sent.");
+	for (size_t r = 0; r < _routes.size(); r++)
+		if (histogramCount(total->latency[r]) != 0)
+			histogram(out, "webserv_request_duration_seconds", route[r], total->latency[r]);
+
+	header(out, "webserv_connections_active", "gauge", "Open client connections.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_connections_active", server[v], static_cast<unsigned long long>(v < active.size() ? active[v] : 0));
+	header(out, "webserv_connections_idle", "gauge", "Keep-alive connections waiting for their next request.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_connections_idle", server[v], static_cast<unsigned long long>(v < idle.size() ? idle[v] : 0));
+	header(out, "webserv_connections_total", "counter", "Connections accepted.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_connections_total", server[v], total->connections[v]);
+	header(out, "webserv_received_bytes_total", "counter", "Bytes read from clients.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_received_bytes_total", server[v], total->bytesIn[v]);
+	header(out, "webserv_sent_bytes_total", "counter", "Bytes sent to clients.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_sent_bytes_total", server[v], total->bytesOut[v]);
+
+	std::vector<std::string> cache;
+	for (size_t v = 0; v < _servers.size(); v++)
+		for (int k = 0; k < METRICS_CACHES; k++)
+			cache.push_back(server[v] + ",cache=\"" + cacheNames[k] + "\"");
+	header(out, "webserv_cache_hits_total", "counter", "Responses served by the CGI cache, or from the result of an identical request in flight.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		for (int k = 0; k < METRICS_CACHES; k++)
+			sample(out, "webserv_cache_hits_total", cache[v * METRICS_CACHES + k], total->cacheHits[v][k]);
+	header(out, "webserv_cache_misses_total", "counter", "Lookups that had to do the work.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		for (int k = 0; k < METRICS_CACHES; k++)
+			sample(out, "webserv_cache_misses_total", cache[v * METRICS_CACHES + k], total->cacheMisses[v][k]);
+	header(out, "webserv_cache_hit_ratio", "gauge", "Hits over lookups since startup.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		for (int k = 0; k < METRICS_CACHES; k++)
+		{
+			unsigned long long hits = total->cacheHits[v][k];
+			unsigned long long lookups = hits + total->cacheMisses[v][k];
+			sample(out, "webserv_cache_hit_ratio", cache[v * METRICS_CACHES + k], lookups ? static_cast<double>(hits) / lookups : 0.0);
+		}
+
+	header(out, "webserv_cgi_spawns_total", "counter", "CGI scripts started.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_cgi_spawns_total", server[v], total->cgiSpawns[v]);
+	header(out, "webserv_cgi_failures_total", "counter", "CGI scripts that timed out or produced no output.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		sample(out, "webserv_cgi_failures_total", server[v], total->cgiFailures[v]);
+	header(out, "webserv_cgi_duration_seconds", "histogram", "CGI script run time, from fork to end of output.");
+	for (size_t v = 0; v < _servers.size(); v++)
+		histogram(out, "webserv_cgi_duration_seconds", server[v], total->cgiDuration[v]);
+
+	header(out, "webserv_io_task_duration_seconds", "histogram", "Disk jobs run on the I/O pool, all workers merged.");
+	histogram(out, "webserv_io_task_duration_seconds", "", total->ioTasks);
+	std::free(total);
+	return (out);
+}
@@ -0,0 +1,85 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#define METRICS_SERVERS 16 // servers past this one share the last slot, relabelled "other"
+#define METRICS_ROUTES 64 // server and location pairs past this one share the last slot, likewise
+#define METRICS_STATUSES 32 // tracked status codes, the last slot is "other"
+#define METRICS_BUCKETS 24 // latency buckets: 16us, 32us ... 2^27us (~134s), then +Inf
+
+enum MetricsMethod { METRICS_GET, METRICS_POST, METRICS_DELETE, METRICS_OTHER, METRICS_METHODS };
+enum MetricsCache { METRICS_CGI_CACHE, METRICS_FLIGHT, METRICS_CACHES };
+
+// Latencies in powers of two of a microsecond, one counter per bucket
+// (made cumulative at scrape time)
+struct MetricsHistogram
+{
+	volatile unsigned long long	buckets[METRICS_BUCKETS + 1];
+	volatile unsigned long long	sum; // microseconds
+
+	void	observe(unsigned long long micros);
+};
+
+/*
+*	Counters of one thread. Only their thread writes them, with plain
+*	increments; a scrape adds up every shard. Aligned 64-bit loads do not
+*	tear, so the worst a scrape sees is an increment that races with it.
+*	Shards are calloc'd: the pages a thread never writes (the request
+*	tables of an I/O worker) are never backed.
+*/
+struct MetricsShard
+{
+	volatile unsigned long long	requests[METRICS_ROUTES][METRICS_METHODS][METRICS_STATUSES];
+	MetricsHistogram			latency[METRICS_ROUTES];
+	volatile unsigned long long	connections[METRICS_SERVERS];
+	volatile unsigned long long	bytesIn[METRICS_SERVERS];
+	volatile unsigned long long	bytesOut[METRICS_SERVERS];
+	volatile unsigned long long	cacheHits[METRICS_SERVERS][METRICS_CACHES];
+	volatile unsigned long long	cacheMisses[METRICS_SERVERS][METRICS_CACHES];
+	volatile unsigned long long	cgiSpawns[METRICS_SERVERS];
+	volatile unsigned long long	cgiFailures[METRICS_SERVERS];
+	MetricsHistogram			cgiDuration[METRICS_SERVERS];
+	MetricsHistogram			ioTasks;
+};
+
+/*
+*	Prometheus metrics, served by a location with "metrics on". Servers and
+*	their locations are registered at startup and get a slot; every thread
+*	that counts something gets its own shard on first use, so nothing on
+*	the request path takes a lock or a locked instruction.
+*/
+class Metrics
+{
+	private:
+		struct Route
+		{
+			int			server; // -1 once the slot is shared
+			std::string	location;
+		};
+		std::vector<std::string>	_servers; // rendered label sets
+		std::vector<Route>			_routes;
+		std::vector<MetricsShard*>	_shards;
+		pthread_mutex_t				_lock; // guards _shards, taken once per thread
+		// Prevent Copying
+		Metrics(const Metrics& other);
+		Metrics&					operator=(const Metrics& other);
+
+		void						sum(MetricsShard& total) const;
+
+	public:
+		Metrics();
+		~Metrics();
+
+		int							addServer(const std::string& name, const std::vector<int>& ports);
+		int							addRoute(int server, const std::string& location);
+		MetricsShard&				local();
+		std::string					render(const std::vector<size_t>& active, const std::vector<size_t>& idle) const;
+
+		static int					methodSlot(const char* method, size_t length);
+		static int					statusSlot(int status);
+};
+
+#endif
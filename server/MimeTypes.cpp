@@ -0,0 +1,152 @@
+#include "MimeTypes.hpp"
+#include <algorithm>
+#include <cctype>
+
+MimeTypes::MimeTypes() : _defaultType(MIME_DEFAULT_TYPE)
+{
+	compile(defaults(), MIME_DEFAULT_TYPE);
+}
+
+MimeTypes::~MimeTypes()
+{
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+// FNV-1a over the lowercased key, seeded
+unsigned int	MimeTypes::hash(const std::string& key, unsigned int seed)
+{
+	unsigned int h = 2166136261u ^ (seed * 16777619u);
+	for (size_t i = 0; i < key.size(); i++)
+	{
+		h ^= (unsigned char)std::tolower(key[i]);
+		h *= 16777619u;
+	}
+	return (h);
+}
+
+struct LargerBucket
+{
+	const std::vector<std::vector<std::string> >&	buckets;
+
+	LargerBucket(const std::vector<std::vector<std::string> >& buckets) : buckets(buckets) {}
+	bool	operator()(size_t a, size_t b) const { return (buckets[a].size() > buckets[b].size()); }
+};
+
+/*
+*	Keys are spread over n buckets, then the largest buckets first each
+*	look for a seed that sends all their keys to free slots. Seed 0 marks
+*	an empty bucket; lookups always verify the extension stored in the slot.
+*/
+void	MimeTypes::compile(const std::map<std::string, std::string>& types, const std::string& defaultType)
+{
+	_defaultType = defaultType;
+	std::map<std::string, std::string> lowered;
+	for (std::map<std::string, std::string>::const_iterator it = types.begin(); it != types.end(); ++it)
+	{
+		std::string extension = it->first;
+		for (size_t i = 0; i < extension.size(); i++)
+			extension[i] = std::tolower(extension[i]);
+		lowered[extension] = it->second;
+	}
+	size_t count = lowered.size() ? lowered.size() : 1;
+	std::vector<std::vector<std::string> > buckets(count);
+	for (std::map<std::string, std::string>::const_iterator it = lowered.begin(); it != lowered.end(); ++it)
+		buckets[hash(it->first, 0) % count].push_back(it->first);
+	std::vector<size_t> order(count);
+	for (size_t b = 0; b < count; b++)
+		order[b] = b;
+	std::stable_sort(order.begin(), order.end(), LargerBucket(buckets));
+
+	_slots.assign(count, Slot());
+	_seeds.assign(count, 0);
+	std::vector<bool> taken(count, false);
+	for (size_t i = 0; i < count && !buckets[order[i]].empty(); i++)
+	{
+		const std::vector<std::string>& keys = buckets[order[i]];
+		for (unsigned int seed = 1; ; seed++)
+		{
+			std::vector<size_t> slots;
+			for (size_t k = 0; k < keys.size(); k++)
+			{
+				size_t slot = hash(keys[k], seed) % count;
+				if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end())
+					break ;
+				slots.push_back(slot);
+			}
+			if (slots.size() != keys.size())
+				continue ;
+			for (size_t k = 0; k < keys.size(); k++)
+			{
+				taken[slots[k]] = true;
+				_slots[slots[k]].extension = keys[k];
+				_slots[slots[k]].type = lowered[keys[k]];
+			}
+			_seeds[order[i]] = seed;
+			break ;
+		}
+	}
+}
+
+// Media type of the file extension of path, the default type when unknown
+const std::string&	MimeTypes::lookup(const std::string& path) const
+{
+	size_t dot = path.find_last_of("./");
+	if (dot == std::string::npos || path[dot] != '.' || _slots.empty())
+		return (_defaultType);
+	std::string extension = path.substr(dot + 1);
+	unsigned int seed = _seeds[hash(extension, 0) % _seeds.size()];
+	if (seed == 0)
+		return (_defaultType);
+	const Slot& slot = _slots[hash(extension, seed) % _slots.size()];
+	if (slot.extension.size() != extension.size())
+		return (_defaultType);
+	for (size_t i = 0; i < extension.size(); i++)
+		if (std::tolower(extension[i]) != slot.extension[i])
+			return (_defaultType);
+	return (slot.type);
+}
+
+std::map<std::string, std::string>	MimeTypes::defaults()
+{
+	static const char* table[][2] = {
+		{"html", "text/html"}, {"htm", "text/html"}, {"shtml", "text/html"},
+		{"css", "text/css"}, {"xml", "text/xml"}, {"txt", "text/plain"},
+		{"csv", "text/csv"}, {"md", "text/markdown"}, {"js", "application/javascript"},
+		{"mjs", "application/javascript"}, {"json", "application/json"},
+		{"atom", "application/atom+xml"}, {"rss", "application/rss+xml"},
+		{"xhtml", "application/xhtml+xml"}, {"wasm", "application/wasm"},
+		{"gif", "image/gif"}, {"jpeg", "image/jpeg"}, {"jpg", "image/jpeg"},
+		{"png", "image/png"}, {"svg", "image/svg+xml"}, {"svgz", "image/svg+xml"},
+		{"tif", "image/tiff"}, {"tiff", "image/tiff"}, {"webp", "image/webp"},
+		{"avif", "image/avif"}, {"ico", "image/x-icon"}, {"bmp", "image/x-ms-bmp"},
+		{"woff", "font/woff"}, {"woff2", "font/woff2"}, {"ttf", "font/ttf"},
+		{"otf", "font/otf"}, {"eot", "application/vnd.ms-fontobject"},
+		{"pdf", "application/pdf"}, {"ps", "application/postscript"},
+		{"rtf", "application/rtf"}, {"doc", "application/msword"},
+		{"xls", "application/vnd.ms-excel"}, {"ppt", "application/vnd.ms-powerpoint"},
+		{"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+		{"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+		{"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+		{"odt", "application/vnd.oasis.opendocument.text"},
+		{"zip", "application/zip"}, {"gz", "application/gzip"}, {"tar", "application/x-tar"},
+		{"7z", "application/x-7z-compressed"}, {"rar", "application/x-rar-compressed"},
+		{"jar", "application/java-archive"}, {"bin", "application/octet-stream"},
+		{"exe", "application/octet-stream"}, {"iso", "application/octet-stream"},
+		{"mid", "audio/midi"}, {"midi", "audio/midi"}, {"mp3", "audio/mpeg"},
+		{"ogg", "audio/ogg"}, {"opus", "audio/ogg"}, {"m4a", "audio/x-m4a"},
+		{"wav", "audio/wav"}, {"flac", "audio/flac"}, {"mp4", "video/mp4"},
+		{"m4v", "video/x-m4v"}, {"mpeg", "video/mpeg"}, {"mpg", "video/mpeg"},
+		{"mov", "video/quicktime"}, {"webm", "video/webm"}, {"ogv", "video/ogg"},
+		{"avi", "video/x-msvideo"}, {"wmv", "video/x-ms-wmv"}, {"flv", "video/x-flv"},
+		{"ts", "video/mp2t"}, {"m3u8", "application/vnd.apple.mpegurl"},
+	};
+	std::map<std::string, std::string> types;
+	for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+		types[table[i][0]] = table[i][1];
+	return (types);
+}
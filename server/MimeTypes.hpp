@@ -0,0 +1,41 @@
+#ifndef MIMETYPES_HPP
+#define MIMETYPES_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define MIME_DEFAULT_TYPE "application/octet-stream"
+
+/*
+*	Extension -> media type table, compiled once when a server builds its
+*	routes into a minimal perfect hash (hash and displace): every known
+*	extension owns one slot, found with two hashes and one comparison, no
+*	probing. Built-in defaults are overridden by the config types block.
+*	Read-only once compiled, so the I/O workers share it freely.
+*/
+class MimeTypes
+{
+	private:
+		struct Slot
+		{
+			std::string	extension;
+			std::string	type;
+		};
+		std::vector<Slot>			_slots;
+		std::vector<unsigned int>	_seeds; // per bucket displacement
+		std::string					_defaultType;
+
+		static unsigned int			hash(const std::string& key, unsigned int seed);
+
+	public:
+		MimeTypes();
+		~MimeTypes();
+
+		void						compile(const std::map<std::string, std::string>& types, const std::string& defaultType);
+		const std::string&			lookup(const std::string& path) const;
+
+		static std::map<std::string, std::string>	defaults();
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "MultipartParser.hpp"
+#include "utils.hpp"
+#include "uploads.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+MultipartParser::MultipartParser(const std::string& boundary)
+	: _delimiter("\r\n--" + boundary), _buffer("\r\n"), _state(PREAMBLE), _partFd(-1), _ioError(false)
+{
+	// the leading CRLF lets the first boundary be found like every other one
+	size_t length = _delimiter.size();
+	for (size_t i = 0; i < 256; i++)
+		_skip[i] = length;
+	for (size_t i = 0; i + 1 < length; i++)
+		_skip[(unsigned char)_delimiter[i]] = length - 1 - i;
+}
+
+MultipartParser::~MultipartParser()
+{
+	if (_state != DONE)
+		fail();
+}
+
+/*
+┌───────────────────────────────────┐
+│              METHOD               │
+└───────────────────────────────────┘
+*/
+
+void	MultipartParser::feed(const char* data, size_t length)
+{
+	if (_state == DONE || _state == FAILED)
+		return ;
+	_buffer.append(data, length);
+	while (true)
+	{
+		if (_state == PREAMBLE || _state == BODY)
+		{
+			size_t pos = findDelimiter();
+			if (pos == std::string::npos)
+			{
+				// keep what could still be the beginning of a delimiter
+				size_t keep = std::min(_buffer.size(), _delimiter.size() - 1);
+				if (_state == BODY && !writePart(_buffer.data(), _buffer.size() - keep))
+					return (fail());
+				consume(_buffer.size() - keep);
+				return ;
+			}
+			if (_state == BODY)
+			{
+				if (!writePart(_buffer.data(), pos))
+					return (fail());
+				closePart();
+			}
+			consume(pos + _delimiter.size());
+			_state = BOUNDARY_TAIL;
+		}
+		else if (_state == BOUNDARY_TAIL)
+		{
+			if (_buffer.size() < 2)
+				return ;
+			if (_buffer.compare(0, 2, "--") == 0)
+			{
+				_state = DONE;
+				std::string().swap(_buffer);
+				return ;
+			}
+			if (_buffer.compare(0, 2, "\r\n") != 0)
+				return (fail());
+			consume(2);
+			_state = HEADERS;
+		}
+		else if (_state == HEADERS)
+		{
+			size_t end = _buffer.find("\r\n\r\n");
+			if (end == std::string::npos)
+			{
+				if (_buffer.size() > MULTIPART_MAX_HEADERS)
+					fail();
+				return ;
+			}
+			if (!openPart(_buffer.substr(0, end + 2)))
+				return (fail());
+			consume(end + 4);
+			_state = BODY;
+		}
+		else
+			return ;
+	}
+}
+
+// The body is complete: anything short of the closing boundary is an error
+bool	MultipartParser::finish()
+{
+	if (_state != DONE)
+	{
+		fail();
+		return (false);
+	}
+	for (size_t i = 0; i < _savedFiles.size(); i++)
+		uploads::indexFile(_savedFiles[i]);
+	return (true);
+}
+
+// Boyer-Moore-Horspool search of the delimiter in the pending bytes
+size_t	MultipartParser::findDelimiter() const
+{
+	size_t length = _delimiter.size();
+	size_t size = _buffer.size();
+	const char* data = _buffer.data();
+	size_t pos = 0;
+	while (size >= length && pos <= size - length)
+	{
+		size_t j = length - 1;
+		while (data[pos + j] == _delimiter[j])
+		{
+			if (j == 0)
+				return (pos);
+			j--;
+		}
+		pos += _skip[(unsigned char)data[pos + length - 1]];
+	}
+	return (std::string::npos);
+}
+
+void	MultipartParser::consume(size_t length)
+{
+	_buffer.erase(0, length);
+}
+
+// Fields without a filename are read through and dropped
+bool	MultipartParser::openPart(const std::string& headers)
+{
+	size_t disposition = headers.find("filename=\"");
+	if (disposition == std::string::npos)
+		return (true);
+	disposition += 10;
+	size_t end = headers.find('"', disposition);
+	if (end == std::string::npos)
+		return (false);
+	std::string fileName = sanitizeFileName(headers.substr(disposition, end - disposition));
+	if (fileName.empty())
+		return (true);
+	std::string path;
+	_partFd = uploads::create(fileName, path);
+	if (_partFd == -1 && errno == EEXIST)
+	{
+		// name taken: keep it recognisable and make it unique
+		size_t dot = fileName.find_last_of('.');
+		if (dot == std::string::npos || dot == 0)
+			dot = fileName.size();
+		_partFd = uploads::createUnique(fileName.substr(0, dot) + "_", fileName.substr(dot), path);
+	}
+	if (_partFd == -1)
+	{
+		_ioError = true;
+		return (false);
+	}
+	_savedFiles.push_back(path);
+	return (true);
+}
+
+bool	MultipartParser::writePart(const char* data, size_t length)
+{
+	if (_partFd == -1 || writeAll(_partFd, data, length))
+		return (true);
+	_ioError = true;
+	return (false);
+}
+
+void	MultipartParser::closePart()
+{
+	if (_partFd != -1)
+		close(_partFd);
+	_partFd = -1;
+}
+
+// A broken or truncated upload leaves nothing half written behind
+void	MultipartParser::fail()
+{
+	closePart();
+	for (size_t i = 0; i < _savedFiles.size(); i++)
+		std::remove(_savedFiles[i].c_str());
+	_savedFiles.clear();
+	std::string().swap(_buffer);
+	_state = FAILED;
+}
+
+/*
+┌───────────────────────────────────┐
+│              GETTER               │
+└───────────────────────────────────┘
+*/
+
+MultipartParser::State				MultipartParser::getState() const {
+	return (_state);
+}
+
+bool								MultipartParser::getIoError() const {
+	return (_ioError);
+}
+
+const std::vector<std::string>&		MultipartParser::getSavedFiles() const {
+	return (_savedFiles);
+}
+
+/*
+┌───────────────────────────────────┐
+│              HELPER               │
+└───────────────────────────────────┘
+*/
+
+std::string	MultipartParser::extractBoundary(const std::string& request)
+{
+	size_t headerEnd = request.find("\r\n\r\n");
+	size_t boundaryPos = request.find("boundary=");
+	if (boundaryPos == std::string::npos || boundaryPos > headerEnd)
+		return ("");
+	boundaryPos += 9;
+	size_t lineEnd = request.find_first_of(";\r\n", boundaryPos);
+	std::string boundary = request.substr(boundaryPos, lineEnd - boundaryPos);
+	if (boundary.size() >= 2 && boundary[0] == '"' && boundary[boundary.size() - 1] == '"')
+		boundary = boundary.substr(1, boundary.size() - 2);
+	return (boundary);
+}
+
+// Keeps the base name only and replaces anything outside [A-Za-z0-9._-]
+std::string	MultipartParser::sanitizeFileName(const std::string& fileName)
+{
+	std::string name = fileName.substr(fileName.find_last_of("/\\") + 1);
+	if (name.size() > 200)
+		name = name.substr(name.size() - 200);
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		if (!isalnum((unsigned char)name[i]) && name[i] != '.' && name[i] != '-' && name[i] != '_')
+			name[i] = '_';
+	}
+	if (!name.empty() && name[0] == '.')
+		name[0] = '_';
+	return (name);
+}
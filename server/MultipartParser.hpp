@@ -0,0 +1,64 @@
+#ifndef MULTIPARTPARSER_HPP
+#define MULTIPARTPARSER_HPP
+
+#include <string>
+#include <vector>
+
+#define MULTIPART_MAX_HEADERS 8192 // part headers larger than this are rejected
+
+/*
+*	Incremental multipart/form-data parser. Body bytes are fed as they are
+*	received; every part that carries a filename is streamed straight to
+*	its own file in the upload store, other fields are skipped.
+*	Memory stays bounded by one receive chunk plus the boundary length:
+*	the delimiter is located with Boyer-Moore-Horspool and everything that
+*	cannot be the start of a delimiter is flushed to disk right away.
+*	feed() and finish() block on the filesystem: the server runs them on
+*	the I/O pool, one task at a time per upload (Server::writeUpload).
+*/
+class MultipartParser
+{
+	public:
+		enum State {
+			PREAMBLE,
+			BOUNDARY_TAIL,
+			HEADERS,
+			BODY,
+			DONE,
+			FAILED
+		};
+
+	private:
+		std::string					_delimiter; // "\r\n--" + boundary
+		size_t						_skip[256];
+		std::string					_buffer;
+		State						_state;
+		int							_partFd;
+		bool						_ioError;
+		std::vector<std::string>	_savedFiles;
+
+		size_t						findDelimiter() const;
+		void						consume(size_t length);
+		bool						openPart(const std::string& headers);
+		bool						writePart(const char* data, size_t length);
+		void						closePart();
+		void						fail();
+		// Prevent Copying
+		MultipartParser(const MultipartParser& other);
+		MultipartParser&			operator=(const MultipartParser& other);
+
+	public:
+		MultipartParser(const std::string& boundary);
+		~MultipartParser();
+
+		void							feed(const char* data, size_t length);
+		bool							finish();
+		State							getState() const;
+		bool							getIoError() const;
+		const std::vector<std::string>&	getSavedFiles() const;
+
+		static std::string				extractBoundary(const std::string& request);
+		static std::string				sanitizeFileName(const std::string& fileName);
+};
+
+#endif
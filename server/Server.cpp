@@ -14,22 +14,41 @@
 #include "WebServer.hpp"
 #include "cookies_session.hpp"
 #include "utils.hpp"
+#include "FsTask.hpp"
 
-Server::Server(std::vector<int>ports, std::string host, std::string root, std::vector<std::string> serverName, size_t clientBodyLimit, std::map<int, std::string> errorPages, std::map<std::string, LocationConfig> locations, WebServer* webserver)
-: _ports(ports), _host(host), _root(root), _serverName(serverName), _clientBodyLimit(clientBodyLimit), _errorPages(errorPages), _locations(locations), _epollFd(-1), _webServer(webserver), _runningPorts()
+Server::Server(std::vector<int>ports, std::string host, std::string root, std::vector<std::string> serverName, size_t clientBodyLimit, std::map<int, std::string> errorPages, std::map<std::string, LocationConfig> locations, GzipConfig gzip, MimeConfig mime, SocketConfig sockets, HeaderConfig headers, AccessLogConfig accessLog, WebServer* webserver)
+: _ports(ports), _host(host), _root(root), _serverName(serverName), _clientBodyLimit(clientBodyLimit), _errorPages(errorPages), _locations(locations), _gzip(gzip), _sockets(sockets), _headers(headers), _accessLogConfig(accessLog), _accessLogSink(-1), _epollFd(-1), _webServer(webserver), _runningPorts()
 {
+	Metrics& metrics = _webServer->getMetrics();
+	_metricsId = metrics.addServer(serverName.empty() ? host : serverName[0], ports);
+	for (std::map<std::string, LocationConfig>::const_iterator it = _locations.begin(); it != _locations.end(); ++it)
+		_metricsRoutes[&it->second] = metrics.addRoute(_metricsId, it->first);
+	_metricsUnrouted = metrics.addRoute(_metricsId, "");
+	// the types block extends and overrides the built-in table
+	std::map<std::string, std::string> types = MimeTypes::defaults();
+	for (std::map<std::string, std::string>::iterator it = mime.types.begin(); it != mime.types.end(); ++it)
+		types[it->first] = it->second;
+	_mimeTypes.compile(types, mime.defaultType);
 	for (size_t i = 0; i < ports.size(); i++)
 	{
-		logs::msg(ports[i], logs::Blue, "Creating Server", true);
+		LOG_MSG(logs::Debug, ports[i], logs::Blue, "Creating Server");
 	}
 }
 
 void Server::run()
 { 
+	if (!_accessLogConfig.path.empty() && _accessLogSink == -1)
+	{
+		try {
+			_accessLogSink = _webServer->getAccessLog().open(_accessLogConfig.path, _accessLogConfig.format);
+		} catch (const std::runtime_error& e) {
+			THROW_MSG(_ports.empty() ? NOPORT : _ports[0], e.what());
+		}
+	}
 	for (size_t i = 0; i < _ports.size(); i++)
 	{
 		int port = _ports[i];
-		logs::msg(port, logs::Blue, "Starting server", true);
+		LOG_MSG(logs::Info, port, logs::Blue, "Starting server");
 		int serverSocketFd = socket(AF_INET, SOCK_STREAM, 0);
 		if (serverSocketFd == -1)
 			THROW_MSG(port, "Socket can't be created");
@@ -50,6 +69,7 @@ void Server::run()
 			close(serverSocketFd);
 			THROW_MSG(port, "Failed to set server socket to non-blocking");
 		}
+		tuneListener(serverSocketFd, port);
 		// init and bind the socket
 		struct sockaddr_in serverSocketId;
 		initSocketId(serverSocketId, port);
@@ -61,7 +81,7 @@ void Server::run()
 			else
 				THROW_MSG(port, "Failed to bind socket");
 		}
-		if (listen(serverSocketFd, MAX_QUEUE) == -1)
+		if (listen(serverSocketFd, _sockets.backlog) == -1)
 		{
 			close(serverSocketFd);
 			THROW_MSG(port, "Failed to listen on socket");
@@ -79,7 +99,7 @@ void Server::run()
 		_serverSocketIds.push_back(serverSocketId);
 		_socketFdToPort[serverSocketFd] = port;
 		_runningPorts.push_back(port);
-		logs::msg(port, logs::Blue, "Server listening", true);
+		LOG_MSG(logs::Info, port, logs::Blue, "Server listening");
 	}
 }
 
@@ -97,12 +117,14 @@ int	Server::treatMethod(struct epoll_event &event, int clientPort)
 
 int Server::handleReadEvent(Client* client, int clientPort)
 {
+	ALLOC_PHASE(PARSE);
 	char buffer[BUFFER_LENGTH];
 	ssize_t bytesRead = recv(client->getClientSocketFd(), buffer, sizeof(buffer) - 1, 0);
 	if (bytesRead == -1 || bytesRead == 0)
 		return bytesRead;
 	buffer[bytesRead] = '\0';
-	client->appendToRequestBuffer(buffer);
+	getMetrics().local().bytesIn[_metricsId] += bytesRead;
+	client->appendToRequestBuffer(buffer, bytesRead);
 	if (client->getState() == Client::READING_HEADERS)
 	{
 		handleReadHeaders(client);
@@ -124,9 +146,20 @@ int Server::handleReadEvent(Client* client, int clientPort)
 	return 1;
 }
 
+// The request head is capped (large_client_header_buffers) so a client
+// can only make the server hold a bounded amount before the body
 void Server::handleReadHeaders(Client* client)
 {
-	if (client->requestBufferContains("\r\n\r\n", 0) != -1) {
+	const std::string& request = client->getRequestBuffer();
+	size_t headerEnd = request.find("\r\n\r\n");
+	size_t lineEnd = request.find("\r\n");
+	size_t lineLength = (lineEnd == std::string::npos) ? request.size() : lineEnd;
+	size_t headLength = (headerEnd == std::string::npos) ? request.size() : headerEnd + 4;
+	if (lineLength > _headers.bufferSize)
+		return (respondWithError(client, ERROR_414_RESPONSE, client->getClientPort()));
+	if (headLength > _headers.buffers * _headers.bufferSize)
+		return (respondWithError(client, ERROR_431_RESPONSE, client->getClientPort()));
+	if (headerEnd != std::string::npos) {
 		client->setHeadersComplete(true);
 		parseRequestHeaders(client);
 	}
@@ -138,6 +171,10 @@ void Server::handleReadBody(Client* client)
 	if (headerEndPos == std::string::npos) return;
 	
 	size_t bodyStartPos = headerEndPos + 4;
+	if (client->getMultipart() || client->getWritingUpload()) {
+		writeUpload(client, bodyStartPos);
+		return ;
+	}
 	size_t totalBufferSize = client->getRequestBuffer().size();
 	if (totalBufferSize > bodyStartPos) {
 		size_t currentBodySize = totalBufferSize - bodyStartPos;
@@ -153,94 +190,223 @@ void Server::handleReadBody(Client* client)
 	}
 }
 
+/*
+*	Multipart body bytes go to disk on the I/O pool in writes of at least
+*	UPLOAD_WRITE_MIN bytes, one at a time per client so the parts land in
+*	order. While a write runs the socket is read up to UPLOAD_BUFFER_MAX
+*	bytes ahead, then left alone until the write is back. The last bytes
+*	are left to the POST handler, which finishes the upload.
+*/
+void Server::writeUpload(Client* client, size_t bodyStart)
+{
+	const std::string& request = client->getRequestBuffer();
+	size_t length = std::min(request.size() - bodyStart,
+		client->getExpectedContentLength() - client->getReceivedContentLength());
+	client->setState(Client::READING_BODY);
+	if (client->getWritingUpload())
+	{
+		if (length >= UPLOAD_BUFFER_MAX)
+			watchClient(client, EPOLLRDHUP);
+		return ;
+	}
+	if (client->getReceivedContentLength() + length >= client->getExpectedContentLength())
+	{
+		client->setBodyComplete(true);
+		client->setParsed(true);
+		client->setState(Client::READY_TO_RESPOND);
+		return ;
+	}
+	if (length < UPLOAD_WRITE_MIN)
+		return ;
+	// a broken body is read through; the POST handler answers it
+	if (client->getMultipart()->getState() == MultipartParser::FAILED)
+		return (client->consumeBody(bodyStart, length));
+	FsTask* task = FsTask::create(FsTask::WRITE_UPLOAD, *this, client, request.data() + bodyStart, length);
+	task->setUpload(client->takeMultipart());
+	client->consumeBody(bodyStart, length);
+	client->setWritingUpload(true);
+	_webServer->getIoPool().submit(task);
+}
+
 void Server::handleReadyToRespond(Client* client, char* buffer, int clientPort)
 {
 	try {
 		cookies::cookTheCookies(buffer, client);
-		std::string response = selectMethod(client->getRequestBuffer().c_str(), clientPort, client->getIsRegisteredCookies());
-		client->setResponse(response);
-		client->setState(Client::WRITING_RESPONSE);
-		switchToWriteMode(client->getClientSocketFd());
 	} catch (const std::runtime_error& e) {
-		std::string errorResponse = method::getErrorHtml(clientPort, e.what(), *this, client->getIsRegisteredCookies());
-		if (errorResponse.empty()) {
-			errorResponse = ERROR_500_RESPONSE; // fallback
-		}
-		client->setResponse(errorResponse);
-		client->setState(Client::WRITING_RESPONSE);
-		client->setKeepAlive(false);
-		switchToWriteMode(client->getClientSocketFd());
+		respondWithError(client, e.what(), clientPort);
+		return ;
+	}
+	dispatchRequest(client, clientPort);
+}
+
+void Server::dispatchRequest(Client* client, int clientPort)
+{
+	try {
+		std::string response = selectMethod(client, clientPort);
+		if (client->getState() == Client::WAITING_RESPONSE)
+			return ;
+		respond(client, response);
+	} catch (const std::runtime_error& e) {
+		respondWithError(client, e.what(), clientPort);
 	}
 }
 
+// One send per EPOLLOUT: what the socket did not take is sent on the next
+// event, and a streamed body is pulled chunk by chunk as the buffer drains
 int Server::handleWriteEvent(Client* client)
 {
+	ALLOC_PHASE(WRITE);
 	if (client->getState() != Client::WRITING_RESPONSE) return -1;
-	std::string response = client->getResponse();
-	ssize_t sentNow = send(client->getClientSocketFd(), response.c_str(), response.size(), 0);
-	if (sentNow <= 0 || ((size_t)sentNow != response.size()))
+	if (client->getBytesSent() == client->getResponse().size())
+	{
+		if (!client->hasFileRange() && !client->fillResponse())
+			return (finishResponse(client));
+		if (client->getBytesSent() == client->getResponse().size())
+			return (sendFileRange(client));
+	}
+	const std::string& response = client->getResponse();
+	size_t bytesSent = client->getBytesSent();
+	ssize_t sentNow = send(client->getClientSocketFd(), response.data() + bytesSent, response.size() - bytesSent, 0);
+	if (sentNow <= 0)
 		return 0;
+	client->setBytesSent(bytesSent + sentNow);
+	client->addBytesOut(sentNow);
+	getMetrics().local().bytesOut[_metricsId] += sentNow;
+	if (client->getBytesSent() < response.size() || client->hasBodyStream())
+		return 1;
+	return (finishResponse(client));
+}
+
+int Server::sendFileRange(Client* client)
+{
+	ssize_t sentNow = client->sendFileRange();
+	if (sentNow <= 0)
+		return 0;
+	client->addBytesOut(sentNow);
+	getMetrics().local().bytesOut[_metricsId] += sentNow;
+	if (client->hasBodyStream())
+		return 1;
+	return (finishResponse(client));
+}
+
+int Server::finishResponse(Client* client)
+{
+	ALLOC_REQUEST_DONE();
+	logAccess(client);
+	recordRequest(client);
 	if (client->getKeepAlive()) {
 		client->resetForNewRequest();
-		switchToReadMode(client->getClientSocketFd());
+		switchToReadMode(client);
 		return 1;
 	} else
 		return 0;
 }
 
-std::string Server::selectMethod(const char* buffer, int port, bool isRegistered)
+// Method and target of the request line, as offsets into the request
+static void	sliceRequestLine(const std::string& request, size_t& methodLength, size_t& pathStart, size_t& pathLength)
+{
+	size_t lineEnd = std::min(request.find("\r\n"), request.size());
+	size_t methodEnd = std::min(request.find(' '), lineEnd);
+	size_t pathEnd = (methodEnd < lineEnd) ? std::min(request.find(' ', methodEnd + 1), lineEnd) : methodEnd;
+	methodLength = methodEnd;
+	pathStart = std::min(methodEnd + 1, pathEnd);
+	pathLength = pathEnd - pathStart;
+}
+
+// Copies the finished request into the access log ring; the line is
+// formatted and written by the log thread
+void Server::logAccess(const Client* client)
+{
+	if (_accessLogSink == -1)
+		return ;
+	AccessEntry entry;
+	const std::string& request = client->getRequestBuffer();
+	size_t methodLength, pathStart, pathLength;
+	sliceRequestLine(request, methodLength, pathStart, pathLength);
+	methodLength = std::min(methodLength, sizeof(entry.method) - 1);
+	pathLength = std::min(pathLength, sizeof(entry.path) - 1);
+	std::memcpy(entry.method, request.data(), methodLength);
+	entry.method[methodLength] = '\0';
+	std::memcpy(entry.path, request.data() + pathStart, pathLength);
+	entry.path[pathLength] = '\0';
+	entry.address = client->getAddress();
+	entry.port = client->getClientPort();
+	entry.status = client->getStatus();
+	entry.sink = _accessLogSink;
+	entry.bytes = client->getBytesOut();
+	entry.latency = client->getRequestStart() ? monotonicMicros() - client->getRequestStart() : 0;
+	entry.time = time(NULL);
+	_webServer->getAccessLog().push(entry);
+}
+
+// Counts the finished request under the location its target matches
+void Server::recordRequest(const Client* client)
+{
+	const std::string& request = client->getRequestBuffer();
+	size_t methodLength, pathStart, pathLength;
+	sliceRequestLine(request, methodLength, pathStart, pathLength);
+	const char* path = request.data() + pathStart;
+	const char* query = static_cast<const char *>(std::memchr(path, '?', pathLength));
+	const LocationConfig* location = matchLocation(path, query ? query - path : pathLength);
+	std::map<const LocationConfig*, int>::const_iterator route = _metricsRoutes.find(location);
+	int slot = (route == _metricsRoutes.end()) ? _metricsUnrouted : route->second;
+	MetricsShard& shard = getMetrics().local();
+	shard.requests[slot][Metrics::methodSlot(request.data(), methodLength)][Metrics::statusSlot(client->getStatus())]++;
+	if (client->getRequestStart())
+		shard.latency[slot].observe(monotonicMicros() - client->getRequestStart());
+}
+
+std::string Server::selectMethod(Client* client, int port)
 {
-	std::string	request(buffer);
+	ALLOC_PHASE(ROUTE);
+	const std::string&	request = client->getRequestBuffer();
 	size_t end = request.find(" ");
 	if (end == std::string::npos) throw std::runtime_error(ERROR_400_RESPONSE);
-	std::string methodName = request.substr(0, end);
-	if (methodName == "GET")
-		return (method::GET(request, port, *this, isRegistered));
-	else if (methodName == "POST")
-		return (method::POST(request, port, *this));
-	else if (methodName == "DELETE")
-		return (method::DELETE(request, *this));
+	if (request.compare(0, end, "GET") == 0)
+		return (method::GET(request, port, *this, client));
+	else if (request.compare(0, end, "POST") == 0)
+		return (method::POST(request, port, *this, client));
+	else if (request.compare(0, end, "DELETE") == 0)
+		return (method::DELETE(request, *this, client));
 	else
 		throw std::runtime_error(ERROR_405_RESPONSE);
 }
 
+// Drains the listener's backlog in one wakeup, up to ACCEPT_BUDGET
+// connections so a connect flood cannot starve the open ones; whatever is
+// left keeps the level-triggered listener readable for the next round
 void Server::acceptClient(int serverSocketFd)
 {
-	struct sockaddr_in	clientSocketId;
-	socklen_t clientSocketLength = sizeof(clientSocketId);
+	ALLOC_PHASE(ACCEPT);
 	int port = _socketFdToPort[serverSocketFd];
-	int clientSocketFd = accept(serverSocketFd, (struct sockaddr *)&clientSocketId, &clientSocketLength);
-	if (clientSocketFd == -1)
-	{
-		CERR_MSG(port, "Failed to accept client connection");
-		return ;
-	}
-	// set the client socket to be non-blocking
-	int retValue = setNonBlocking(clientSocketFd);
-	if (retValue == -1)
-	{
-		CERR_MSG(port, "Failed to retrieve socket flags");
-		sendErrorAndCloseClient(clientSocketFd, ERROR_500_RESPONSE, port);
-		return;
-	}
-	else if (retValue == -2)
-	{
-		CERR_MSG(port, "Failed to set client socket to non-blocking");
-		sendErrorAndCloseClient(clientSocketFd, ERROR_500_RESPONSE, port);
-		return;
-	}
-	struct epoll_event newEventClient;
-	newEventClient.events = EPOLLIN; // level-triggered
-	newEventClient.data.fd = clientSocketFd;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, clientSocketFd, &newEventClient) == -1)
+	for (int accepted = 0; accepted < ACCEPT_BUDGET; accepted++)
 	{
-		CERR_MSG(port, "Failed to add client socket to epoll");
-		sendErrorAndCloseClient(clientSocketFd, ERROR_500_RESPONSE, port);
-		return;
+		struct sockaddr_in	clientSocketId;
+		socklen_t clientSocketLength = sizeof(clientSocketId);
+		int clientSocketFd = accept4(serverSocketFd, (struct sockaddr *)&clientSocketId, &clientSocketLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (clientSocketFd == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue ;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				CERR_MSG(port, "Failed to accept client connection");
+			return ;
+		}
+		tuneClient(clientSocketFd, port);
+		struct epoll_event newEventClient;
+		newEventClient.events = EPOLLIN; // level-triggered
+		newEventClient.data.fd = clientSocketFd;
+		if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, clientSocketFd, &newEventClient) == -1)
+		{
+			CERR_MSG(port, "Failed to add client socket to epoll");
+			sendErrorAndCloseClient(clientSocketFd, ERROR_500_RESPONSE, port);
+			continue ;
+		}
+		Client *newClient = new Client(clientSocketFd, clientSocketId, port);
+		_clients.insert(std::make_pair(clientSocketFd, newClient));
+		getMetrics().local().connections[_metricsId]++;
+		_webServer->registerClientFd(clientSocketFd, this);
 	}
-	Client *newClient = new Client(clientSocketFd, clientSocketId, port);
-	_clients.insert(std::make_pair(clientSocketFd, newClient));
-	_webServer->registerClientFd(clientSocketFd, this);
 }
 
 void Server::sendErrorAndCloseClient(int clientSocketFd, const std::string &errorResponse, int port)
@@ -251,20 +417,19 @@ void Server::sendErrorAndCloseClient(int clientSocketFd, const std::string &erro
 	_webServer->unregisterClientFd(clientSocketFd);
 }
 
+// The Client owns its socket and closes it when deleted; with I/O workers
+// and the access log opening files, a second close could hit one of theirs
 void Server::closeClient(struct epoll_event &event, int port)
 {
 	int clientSocketFd = event.data.fd;
-	if (_clients.find(clientSocketFd) == _clients.end()) return;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_DEL, clientSocketFd, NULL) == -1)
-	{
-		close(clientSocketFd);
-		_webServer->unregisterClientFd(clientSocketFd);
-		THROW_MSG(port, "Failed to remove client socket from epoll");
-	}
-	delete _clients[clientSocketFd];
-	_clients.erase(clientSocketFd);
-	close(clientSocketFd);
+	std::map<int, Client *>::iterator it = _clients.find(clientSocketFd);
+	if (it == _clients.end()) return;
+	bool removed = epoll_ctl(_epollFd, EPOLL_CTL_DEL, clientSocketFd, NULL) != -1;
+	delete it->second;
+	_clients.erase(it);
 	_webServer->unregisterClientFd(clientSocketFd);
+	if (!removed)
+		THROW_MSG(port, "Failed to remove client socket from epoll");
 }
 
 int	Server::setNonBlocking(int fd)
@@ -284,6 +449,30 @@ void Server::initSocketId(struct sockaddr_in &socketId, int port)
 	socketId.sin_addr.s_addr = INADDR_ANY;
 }
 
+// Tuning is best effort: a kernel refusing an option only costs performance.
+// Buffer sizes are set before listen() so the window scale offered in the
+// handshake matches, and accepted sockets inherit them
+void Server::tuneListener(int serverSocketFd, int port)
+{
+	if (_sockets.rcvBuf && setsockopt(serverSocketFd, SOL_SOCKET, SO_RCVBUF, &_sockets.rcvBuf, sizeof(int)) == -1)
+		CERR_MSG(port, "Failed to set SO_RCVBUF");
+	if (_sockets.sndBuf && setsockopt(serverSocketFd, SOL_SOCKET, SO_SNDBUF, &_sockets.sndBuf, sizeof(int)) == -1)
+		CERR_MSG(port, "Failed to set SO_SNDBUF");
+	// wake up on the first request bytes rather than on the bare handshake
+	if (_sockets.deferAccept && setsockopt(serverSocketFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &_sockets.deferAccept, sizeof(int)) == -1)
+		CERR_MSG(port, "Failed to set TCP_DEFER_ACCEPT");
+	if (_sockets.fastOpen && setsockopt(serverSocketFd, IPPROTO_TCP, TCP_FASTOPEN, &_sockets.fastOpen, sizeof(int)) == -1)
+		CERR_MSG(port, "Failed to set TCP_FASTOPEN");
+}
+
+// Responses go out in one send when possible, so Nagle only delays the tail
+void Server::tuneClient(int clientSocketFd, int port)
+{
+	int noDelay = _sockets.tcpNoDelay ? 1 : 0;
+	if (setsockopt(clientSocketFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) == -1)
+		CERR_MSG(port, "Failed to set TCP_NODELAY");
+}
+
 bool Server::isServerSocket(int fd)
 {
 	for (size_t i = 0; i < _serverSocketFds.size(); i++)
@@ -295,13 +484,21 @@ bool Server::isServerSocket(int fd)
 }
 
 const LocationConfig* Server::matchLocation(std::string& path)
+{
+	return (matchLocation(path.data(), path.size()));
+}
+
+// Takes a slice so a path borrowed from the request buffer needs no copy
+const LocationConfig* Server::matchLocation(const char* path, size_t length)
 {
 	const LocationConfig* bestMatch = NULL;
 	size_t bestLength = 0;
 	for (std::map<std::string, LocationConfig>::const_iterator it = _locations.begin(); it != _locations.end(); ++it)
 	{
 		const std::string &locationPath = it->first;
-		if (path == locationPath)
+		if (length < locationPath.length() || std::memcmp(path, locationPath.data(), locationPath.length()) != 0)
+			continue ;
+		if (length == locationPath.length())
 		{
 			if (locationPath == "/")
 				return (&it->second);
@@ -309,13 +506,10 @@ const LocationConfig* Server::matchLocation(std::string& path)
 				return (NULL);
 			return (&it->second);
 		}
-		if (path.compare(0, locationPath.length(), locationPath) == 0)
+		if (locationPath.length() > bestLength)
 		{
-			if (locationPath.length() > bestLength)
-			{
-				bestLength = locationPath.length();
-				bestMatch = &it->second;
-			}
+			bestLength = locationPath.length();
+			bestMatch = &it->second;
 		}
 	}
 	if (bestMatch && bestMatch->getLocationAutoIndex())
@@ -325,6 +519,8 @@ const LocationConfig* Server::matchLocation(std::string& path)
 
 Server::~Server()
 {
+	while (!_cgiProcesses.empty())
+		killCgi(_cgiProcesses.begin()->second);
 	for (std::map<int, Client *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
 	{
 		delete it->second;
@@ -367,6 +563,29 @@ ssize_t Server::getClientBodyLimit() const
 	return (_clientBodyLimit);
 }
 
+int Server::getEventBatch() const
+{
+	return (_sockets.eventBatch);
+}
+
+const MimeTypes& Server::getMimeTypes() const
+{
+	return (_mimeTypes);
+}
+
+CgiCache& Server::getCgiCache()
+{
+	return (_cgiCache);
+}
+
+Client*	Server::findClient(int clientSocketFd, unsigned long clientId)
+{
+	std::map<int, Client *>::iterator it = _clients.find(clientSocketFd);
+	if (it == _clients.end() || !it->second || it->second->getId() != clientId)
+		return (NULL);
+	return (it->second);
+}
+
 int	Server::getClientPort(int fd)
 {
 	Client *client = _clients[fd];
@@ -375,6 +594,33 @@ int	Server::getClientPort(int fd)
 	return (client->getClientPort());
 }
 
+Metrics& Server::getMetrics()
+{
+	return (_webServer->getMetrics());
+}
+
+int Server::getMetricsId() const
+{
+	return (_metricsId);
+}
+
+size_t Server::getClientCount() const
+{
+	size_t count = 0;
+	for (std::map<int, Client *>::const_iterator it = _clients.begin(); it != _clients.end(); ++it)
+		count += (it->second != NULL);
+	return (count);
+}
+
+// Kept-alive connections between two requests
+size_t Server::getIdleClientCount() const
+{
+	size_t count = 0;
+	for (std::map<int, Client *>::const_iterator it = _clients.begin(); it != _clients.end(); ++it)
+		count += (it->second && it->second->getState() == Client::READING_HEADERS && it->second->getRequestBuffer().empty());
+	return (count);
+}
+
 /*
 ┌───────────────────────────────────┐
 │              SETTER               │
@@ -394,11 +640,12 @@ void Server::setEpollFd(int epollFd)
 
 void Server::parseRequestHeaders(Client* client)
 {
-	std::string request = client->getRequestBuffer();
+	const std::string& request = client->getRequestBuffer();
 	parseContentLength(request, client);
 	parseKeepAlive(request, client);
 	if (client->getHasContentLength()) {
 		client->setState(Client::READING_BODY);
+		prepareMultipartUpload(client);
 	} else {
 		client->setState(Client::READY_TO_RESPOND);
 		client->setParsed(true);
@@ -414,11 +661,8 @@ void	Server::parseContentLength(const std::string& request, Client* client)
 			++pos;
 		size_t endPos = request.find("\r\n", pos);
 		if (endPos != std::string::npos) {
-			std::string lengthStr = request.substr(pos, endPos - pos);
-			std::stringstream ss(lengthStr);
-			size_t contentLength;
-			ss >> contentLength;
-			client->setExpectedContentLength(contentLength);
+			// read in place, the header line is never copied
+			client->setExpectedContentLength(std::strtoul(request.c_str() + pos, NULL, 10));
 			client->setHasContentLength(true);
 		}
 	}
@@ -433,47 +677,530 @@ void	Server::parseKeepAlive(const std::string& request, Client* client)
 			++pos;
 		size_t endPos = request.find("\r\n", pos);
 		if (endPos != std::string::npos) {
-			std::string connectionValue = request.substr(pos, endPos - pos);
-			client->setKeepAlive(connectionValue == "keep-alive" || connectionValue == "Keep-Alive");
+			size_t length = endPos - pos;
+			client->setKeepAlive(request.compare(pos, length, "keep-alive") == 0 || request.compare(pos, length, "Keep-Alive") == 0);
 		}
 	} else
 		client->setKeepAlive(true);
 }
 
+// A multipart upload to a location that accepts it is parsed while the
+// body arrives instead of being buffered whole. Anything method::POST
+// would refuse stays buffered so it is answered with the usual error.
+void	Server::prepareMultipartUpload(Client* client)
+{
+	const std::string& request = client->getRequestBuffer();
+	size_t headerEnd = request.find("\r\n\r\n");
+	size_t typePos = request.find("Content-Type: multipart/form-data");
+	if (request.compare(0, 5, "POST ") != 0 || typePos == std::string::npos || typePos > headerEnd)
+		return ;
+	size_t end = request.find(' ', 5);
+	if (end == std::string::npos)
+		return ;
+	std::string path = request.substr(5, end - 5);
+	path = path.substr(0, path.find('?'));
+	if (path.compare(0, 7, "/delete") == 0)
+		return ;
+	try {
+		const LocationConfig* location = matchLocation(path);
+		if (!location || !method::checkPermissions("POST", location))
+			return ;
+		if (!location->getLocationIndex().empty()
+			&& method::isCGIScript((location->getLocationRoot() + location->getLocationIndex()).c_str()))
+			return ;
+	} catch (const std::runtime_error& e) {
+		return ;
+	}
+	if ((ssize_t)client->getExpectedContentLength() > _clientBodyLimit)
+		return ;
+	std::string boundary = MultipartParser::extractBoundary(request);
+	if (!boundary.empty())
+		client->startMultipart(new MultipartParser(boundary));
+}
+
 /*
 ┌───────────────────────────────────┐
 │              HELPER               │
 └───────────────────────────────────┘
 */
 
-void Server::switchToWriteMode(int clientSocketFd)
+void Server::switchToWriteMode(Client* client)
 {
-	struct epoll_event writeEvent;
-	writeEvent.events = EPOLLOUT;
-	writeEvent.data.fd = clientSocketFd;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, clientSocketFd, &writeEvent) == -1)
-		throw std::runtime_error(ERROR_500_RESPONSE);
+	watchClient(client, EPOLLOUT);
 }
 
-void Server::switchToReadMode(int clientSocketFd)
+void Server::switchToReadMode(Client* client)
 {
-	struct epoll_event readEvent;
-	readEvent.events = EPOLLIN; // level-triggered
-	readEvent.data.fd = clientSocketFd;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, clientSocketFd, &readEvent) == -1)
+	watchClient(client, EPOLLIN); // level-triggered
+}
+
+// The interest set is only changed when it differs from the current one
+void Server::watchClient(Client* client, uint32_t events)
+{
+	if (client->getEpollEvents() == events)
+		return ;
+	struct epoll_event event;
+	event.events = events;
+	event.data.fd = client->getClientSocketFd();
+	if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, client->getClientSocketFd(), &event) == -1)
 		throw std::runtime_error(ERROR_500_RESPONSE);
+	client->setEpollEvents(events);
+}
+
+/*
+*	The socket is almost always writable when a response is ready, so the
+*	head is sent right away. EPOLLOUT is only armed when bytes remain (or
+*	the body is streamed); a small keep-alive response then costs one send
+*	and no epoll_ctl, the client goes straight back to reading.
+*/
+void Server::respond(Client* client, const std::string& response, BodyStream* stream)
+{
+	ALLOC_PHASE(WRITE);
+	if (response.compare(0, 9, "HTTP/1.1 ") == 0)
+		client->setStatus(std::atoi(response.c_str() + 9));
+	std::string compressed;
+	client->setResponse(compressResponse(client, response, stream, compressed) ? compressed : response);
+	client->setBodyStream(stream);
+	client->setState(Client::WRITING_RESPONSE);
+	const std::string& pending = client->getResponse();
+	ssize_t sentNow = send(client->getClientSocketFd(), pending.data(), pending.size(), 0);
+	if (sentNow > 0)
+	{
+		client->setBytesSent(sentNow);
+		client->addBytesOut(sentNow);
+		getMetrics().local().bytesOut[_metricsId] += sentNow;
+	}
+	if (sentNow > 0 && client->getBytesSent() == pending.size() && !client->hasBodyStream()
+		&& client->getKeepAlive())
+		finishResponse(client);
+	else
+		switchToWriteMode(client);
+}
+
+/*
+*	gzip: generated responses (pages, listings, error pages, CGI output)
+*	are deflated when the client accepts gzip and their type is listed in
+*	gzip_types. A whole body under gzip_min_length is left alone; a
+*	chunked body is compressed piece by piece as it streams. Static files
+*	(file-backed bodies) are precompressed with gzip_static instead.
+*	Returns false when the response goes out as is.
+*/
+bool Server::compressResponse(const Client* client, const std::string& response, BodyStream*& stream, std::string& compressed)
+{
+	size_t headEnd = response.find("\r\n\r\n");
+	if (!_gzip.enabled || headEnd == std::string::npos || (stream && !stream->isChunked())
+		|| response.compare(0, 9, "HTTP/1.1 ") != 0)
+		return (false);
+	int status = std::atoi(response.c_str() + 9);
+	size_t length;
+	if (status < 200 || status == 204 || status == 206 || status == 304
+		|| (findHeaderValue(response, "Content-Encoding", length) && length > 0))
+		return (false);
+	std::string type = getHeaderValue(response, "Content-Type");
+	type = type.substr(0, type.find(';'));
+	const char* acceptEncoding = findHeaderValue(client->getRequestBuffer(), "Accept-Encoding", length);
+	if (_gzip.types.find(type) == _gzip.types.end()
+		|| (!stream && response.size() - headEnd - 4 < _gzip.minLength)
+		|| !acceptEncoding || !method::acceptsEncoding(acceptEncoding, length, "gzip"))
+		return (false);
+
+	GzipPool& pool = _webServer->getGzipPool();
+	std::string body;
+	if (stream)
+	{
+		z_stream* deflater = pool.acquire(_gzip.level);
+		if (!deflater)
+			return (false);
+		stream = new GzipStream(stream, pool, _gzip.level, deflater);
+	}
+	else if (!gzip::compress(pool, _gzip.level, response.substr(headEnd + 4), body))
+		return (false);
+	// head without the Content-Length of the plain body; a strong ETag
+	// becomes weak since the bytes are no longer the ones it names
+	std::string head;
+	size_t lineStart = 0;
+	while (lineStart < headEnd)
+	{
+		size_t lineEnd = response.find("\r\n", lineStart);
+		if (strncasecmp(response.c_str() + lineStart, "ETag: \"", 7) == 0)
+			head += "ETag: W/" + response.substr(lineStart + 6, lineEnd + 2 - lineStart - 6);
+		else if (strncasecmp(response.c_str() + lineStart, "Content-Length:", 15) != 0)
+			head.append(response, lineStart, lineEnd + 2 - lineStart);
+		lineStart = lineEnd + 2;
+	}
+	if (!stream)
+		head += "Content-Length: " + to_string(body.size()) + "\r\n";
+	compressed = head + "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n\r\n" + body;
+	return (true);
+}
+
+void Server::respondWithError(Client* client, const std::string& errorResponse, int clientPort)
+{
+	ALLOC_PHASE(WRITE);
+	std::string response = method::getErrorHtml(clientPort, errorResponse, *this, client->getIsRegisteredCookies());
+	if (response.empty()) {
+		response = ERROR_500_RESPONSE; // fallback
+	}
+	// a 4xx to a request read in full leaves the connection usable; a
+	// malformed request (400), a body left unread or a server error closes it
+	int status = std::atoi(response.c_str() + 9);
+	if (status == 400 || status >= 500 || !client->getParsed())
+	{
+		client->setKeepAlive(false);
+		size_t lineEnd = response.find("\r\n");
+		if (lineEnd != std::string::npos)
+			response.insert(lineEnd + 2, "Connection: close\r\n");
+	}
+	respond(client, response);
+}
+
+// Parks the client until its response is produced elsewhere; only a
+// hang up is watched so a pipelined request does not spin the loop
+void Server::suspendClient(Client* client)
+{
+	watchClient(client, EPOLLRDHUP);
+	client->setState(Client::WAITING_RESPONSE);
+}
+
+/*
+┌───────────────────────────────────┐
+│             DISK I/O              │
+└───────────────────────────────────┘
+*/
+
+// Runs the blocking part of a request on the I/O pool; the client waits
+// like it does for a CGI and is answered from finishIo
+void Server::offload(IoTask* task, Client* client)
+{
+	ALLOC_PHASE(HANDLE);
+	if (client->getBypassFlight())
+		task->setFlightKey("");
+	const std::string& key = task->getFlightKey();
+	try {
+		if (!key.empty() && joinFlight(key, client))
+		{
+			task->release();
+			return ;
+		}
+		suspendClient(client);
+	} catch (const std::runtime_error& e) {
+		task->release();
+		throw;
+	}
+	if (!key.empty())
+	{
+		_flights.start(key);
+		countCache(METRICS_FLIGHT, false);
+	}
+	_webServer->getIoPool().submit(task);
+}
+
+void Server::finishIo(IoTask* task)
+{
+	ALLOC_PHASE(HANDLE);
+	MultipartParser* upload = task->takeUpload();
+	if (upload)
+		return (resumeUpload(task, upload));
+	std::vector<SingleFlight::Waiter> waiters;
+	if (!task->getFlightKey().empty())
+		waiters = _flights.land(task->getFlightKey());
+	// the task's own client first, then the waiters. With waiters, a
+	// streamed body (an open file) is never sent itself: each client gets
+	// its own copy, taken before anything is read from it. Only a body
+	// that cannot be copied sends a client back to run the request alone
+	BodyStream* stream = task->takeStream();
+	bool shared = !waiters.empty();
+	for (size_t i = 0; i <= waiters.size(); i++)
+	{
+		Client* client = i == 0 ? findClient(task->getClientFd(), task->getClientId())
+			: findClient(waiters[i - 1].first, waiters[i - 1].second);
+		if (!client || client->getState() != Client::WAITING_RESPONSE)
+			continue;
+		try {
+			BodyStream* body = NULL;
+			bool replay = false;
+			if (task->getError().empty() && stream)
+			{
+				if (!shared)
+				{
+					body = stream;
+					stream = NULL;
+				}
+				else if (!(body = stream->share()))
+					replay = true;
+			}
+			// a waiter is a hit only when it is answered from this read
+			if (i > 0)
+				countCache(METRICS_FLIGHT, !replay);
+			if (!task->getError().empty())
+				respondWithError(client, task->getError(), client->getClientPort());
+			else if (replay)
+			{
+				client->setBypassFlight(true);
+				dispatchRequest(client, client->getClientPort());
+			}
+			else
+				respond(client, task->getResponse(), body);
+		} catch (const std::runtime_error& e) {
+			CERR_MSG(client->getClientPort(), "Failed to resume client waiting on disk I/O");
+		}
+	}
+	delete stream;
+	task->release();
+}
+
+// An upload write is back: the parser returns to its client, which goes
+// on with the body bytes that arrived meanwhile
+void Server::resumeUpload(IoTask* task, MultipartParser* parser)
+{
+	Client* client = findClient(task->getClientFd(), task->getClientId());
+	task->release();
+	if (!client || !client->getWritingUpload())
+	{
+		delete parser;
+		return ;
+	}
+	client->setWritingUpload(false);
+	client->startMultipart(parser);
+	try {
+		switchToReadMode(client);
+		writeUpload(client, client->getRequestBuffer().find("\r\n\r\n") + 4);
+		if (client->getState() == Client::READY_TO_RESPOND)
+			dispatchRequest(client, client->getClientPort());
+	} catch (const std::runtime_error& e) {
+		respondWithError(client, e.what(), client->getClientPort());
+	}
+}
+
+/*
+┌───────────────────────────────────┐
+│                CGI                │
+└───────────────────────────────────┘
+*/
+
+bool Server::isCgiPipe(int fd)
+{
+	return (_cgiProcesses.find(fd) != _cgiProcesses.end());
+}
+
+// Returns true when an identical request is already running, in which case
+// the client has been attached to it and will get the same response; the
+// flight hit is counted when that response reaches it
+bool Server::joinFlight(const std::string& key, Client* client)
+{
+	if (!_flights.inFlight(key))
+		return (false);
+	suspendClient(client);
+	_flights.join(key, client->getClientSocketFd(), client->getId());
+	return (true);
+}
+
+void Server::startCgi(CgiProcess* cgi, Client* client)
+{
+	int fds[2] = { cgi->getStdoutFd(), cgi->getStdinFd() };
+	for (int i = 0; i < 2 && fds[i] != -1; i++)
+	{
+		struct epoll_event pipeEvent;
+		pipeEvent.events = (i == 0) ? EPOLLIN : EPOLLOUT;
+		pipeEvent.data.fd = fds[i];
+		if (setNonBlocking(fds[i]) != 0 || epoll_ctl(_epollFd, EPOLL_CTL_ADD, fds[i], &pipeEvent) == -1)
+		{
+			if (i == 1)
+				epoll_ctl(_epollFd, EPOLL_CTL_DEL, fds[0], NULL);
+			kill(-cgi->getPid(), SIGKILL);
+			_cgiZombies.push_back(cgi->getPid());
+			close(fds[0]);
+			if (fds[1] != -1)
+				close(fds[1]);
+			delete cgi;
+			throw std::runtime_error(ERROR_500_RESPONSE);
+		}
+	}
+	for (int i = 0; i < 2 && fds[i] != -1; i++)
+	{
+		_cgiProcesses[fds[i]] = cgi;
+		_webServer->registerClientFd(fds[i], this);
+	}
+	if (cgi->getCoalesced())
+	{
+		_flights.start(cgi->getCacheKey());
+		countCache(METRICS_FLIGHT, false);
+	}
+	getMetrics().local().cgiSpawns[_metricsId]++;
+	suspendClient(client);
+}
+
+// Both pipes of a script are served here: EPOLLOUT on stdin feeds the next
+// slice of the body, EPOLLIN on stdout collects output until EOF
+void Server::handleCgiEvent(int fd)
+{
+	CgiProcess* cgi = _cgiProcesses[fd];
+	if (fd == cgi->getStdinFd())
+	{
+		if (!cgi->writeInput())
+			closeCgiInput(cgi);
+		return ;
+	}
+	char buffer[BUFFER_LENGTH];
+	ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+	if (bytesRead > 0)
+	{
+		cgi->appendOutput(buffer, bytesRead);
+		return ;
+	}
+	finishCgi(cgi);
+}
+
+void Server::closeCgiInput(CgiProcess* cgi)
+{
+	int fd = cgi->getStdinFd();
+	if (fd == -1)
+		return ;
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+	_webServer->unregisterClientFd(fd);
+	_cgiProcesses.erase(fd);
+	cgi->setStdinFd(-1);
+}
+
+void Server::finishCgi(CgiProcess* cgi)
+{
+	closeCgiInput(cgi);
+	int fd = cgi->getStdoutFd();
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+	_webServer->unregisterClientFd(fd);
+	_cgiProcesses.erase(fd);
+	if (waitpid(cgi->getPid(), NULL, WNOHANG) == 0)
+		_cgiZombies.push_back(cgi->getPid());
+
+	bool failed = cgi->getTimedOut() || cgi->getOutput().empty();
+	MetricsShard& shard = getMetrics().local();
+	shard.cgiDuration[_metricsId].observe(monotonicMicros() - cgi->getStartMicros());
+	if (failed)
+		shard.cgiFailures[_metricsId]++;
+	std::string response;
+	int maxAge = -1;
+	if (!failed)
+	{
+		response = method::parseCGIResponse(cgi->getOutput(), maxAge);
+		if (cgi->getCacheable() && maxAge != 0)
+			_cgiCache.store(cgi->getCacheKey(), response, maxAge > 0 ? maxAge : cgi->getDefaultTtl());
+	}
+	// a private response (no-store, Set-Cookie...) only goes to the client
+	// that started the script, the others run the script on their own
+	bool shareable = failed || maxAge != 0;
+	std::vector<SingleFlight::Waiter> waiters;
+	if (cgi->getCoalesced())
+		waiters = _flights.land(cgi->getCacheKey());
+	waiters.insert(waiters.begin(), SingleFlight::Waiter(cgi->getClientFd(), cgi->getClientId()));
+	delete cgi;
+	for (size_t i = 0; i < waiters.size(); i++)
+	{
+		Client* client = findClient(waiters[i].first, waiters[i].second);
+		if (!client || client->getState() != Client::WAITING_RESPONSE)
+			continue;
+		if (i > 0)
+			countCache(METRICS_FLIGHT, failed || shareable);
+		try {
+			if (failed)
+				respondWithError(client, ERROR_500_RESPONSE, client->getClientPort());
+			else if (i == 0 || shareable)
+				respond(client, response);
+			else
+			{
+				client->setBypassFlight(true);
+				dispatchRequest(client, client->getClientPort());
+			}
+		} catch (const std::runtime_error& e) {
+			CERR_MSG(client->getClientPort(), "Failed to resume client waiting on CGI");
+		}
+	}
+}
+
+void Server::checkCgiTimeouts()
+{
+	time_t now = time(0);
+	std::vector<CgiProcess *> expired;
+	for (std::map<int, CgiProcess *>::iterator it = _cgiProcesses.begin(); it != _cgiProcesses.end(); ++it)
+	{
+		if (it->first == it->second->getStdoutFd() && it->second->hasExpired(now))
+			expired.push_back(it->second);
+	}
+	for (size_t i = 0; i < expired.size(); i++)
+	{
+		CERR_MSG(getPort(), "CGI timed out, killing script");
+		kill(-expired[i]->getPid(), SIGKILL);
+		expired[i]->setTimedOut(true);
+		finishCgi(expired[i]);
+	}
+	reapCgiZombies();
+}
+
+// Used on shutdown: no response is sent, the script is just stopped
+void Server::killCgi(CgiProcess* cgi)
+{
+	closeCgiInput(cgi);
+	kill(-cgi->getPid(), SIGKILL);
+	waitpid(cgi->getPid(), NULL, 0);
+	close(cgi->getStdoutFd());
+	_webServer->unregisterClientFd(cgi->getStdoutFd());
+	_cgiProcesses.erase(cgi->getStdoutFd());
+	delete cgi;
+}
+
+void Server::reapCgiZombies()
+{
+	for (size_t i = 0; i < _cgiZombies.size();)
+	{
+		if (waitpid(_cgiZombies[i], NULL, WNOHANG) != 0)
+			_cgiZombies.erase(_cgiZombies.begin() + i);
+		else
+			i++;
+	}
 }
 
 void Server::shutdown()
 {
+	while (!_cgiProcesses.empty())
+		killCgi(_cgiProcesses.begin()->second);
 	for (std::map<int, Client *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
 	{
-		if (it->second)
-			close(it->first);
+		_webServer->unregisterClientFd(it->first);
+		delete it->second;
 	}
+	_clients.clear();
 	for (size_t i = 0; i < _serverSocketFds.size(); i++)
 	{
-		logs::msg(_ports[i], logs::Blue, "Shutting down server", true);
+		LOG_MSG(logs::Info, _ports[i], logs::Blue, "Shutting down server");
+		_webServer->unregisterClientFd(_serverSocketFds[i]);
 		close(_serverSocketFds[i]);
 	}
+	_serverSocketFds.clear();
+}
+
+/*
+┌───────────────────────────────────┐
+│              METRICS              │
+└───────────────────────────────────┘
+*/
+
+void Server::countCache(MetricsCache cache, bool hit)
+{
+	MetricsShard& shard = getMetrics().local();
+	if (hit)
+		shard.cacheHits[_metricsId][cache]++;
+	else
+		shard.cacheMisses[_metricsId][cache]++;
+}
+
+// The response of a location with "metrics on", built on the event loop
+std::string Server::renderMetrics()
+{
+	std::string body = _webServer->renderMetrics();
+	return ("HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		"Cache-Control: no-store\r\n"
+		"Content-Length: " + to_string(body.size()) + "\r\n"
+		"\r\n" + body);
 }
@@ -17,22 +17,34 @@
 
 #include "Client.hpp"
 #include "method.hpp"
+#include "CgiCache.hpp"
+#include "CgiProcess.hpp"
+#include "SingleFlight.hpp"
+#include "IoPool.hpp"
+#include "MimeTypes.hpp"
+#include "AllocStats.hpp"
+#include "Metrics.hpp"
+#include "uploads.hpp"
 #include "../parse/LocationConfig.hpp"
+#include "../parse/ServerConfig.hpp"
 #include <vector>
 #include <map>
 #include <iostream>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <cstring>
 #include <fcntl.h>
 #include <sys/epoll.h>
 #include <utility>
 #include <cstdlib>
+#include <signal.h>
 
-#define MAX_QUEUE 10
 #define BUFFER_LENGTH 8192 // 8kb 
-#define UPLOAD_PATH "./www/uploads/"
+#define ACCEPT_BUDGET 64 // connections taken per listener wakeup
+#define UPLOAD_WRITE_MIN 65536 // upload body gathered before a write is queued
+#define UPLOAD_BUFFER_MAX 262144 // upload body read ahead while a write of it runs
 #define THROW_MSG(port, msg) throw std::runtime_error("\e[31m[" + to_string(port) + "]\e[0m\t" + "\e[2m" + msg + "\e[0m")
 
 class WebServer;
@@ -48,6 +60,12 @@ class Server
 		ssize_t									_clientBodyLimit;
 		std::map<int, std::string> 				_errorPages;
 		std::map<std::string, LocationConfig>	_locations;
+		GzipConfig								_gzip;
+		SocketConfig							_sockets;
+		HeaderConfig							_headers;
+		AccessLogConfig							_accessLogConfig;
+		int										_accessLogSink; // -1 when access_log is off
+		MimeTypes								_mimeTypes;
 		// Server
 		std::vector<int>						_serverSocketFds;
 		std::vector<struct sockaddr_in>			_serverSocketIds;
@@ -56,23 +74,46 @@ class Server
 		int										_epollFd;
 		WebServer*								_webServer;
 		std::vector<int>						_runningPorts;
+		CgiCache								_cgiCache;
+		std::map<int, CgiProcess *>				_cgiProcesses; // stdin and stdout pipe fds -> process
+		std::vector<pid_t>						_cgiZombies;
+		SingleFlight							_flights;
+		// metrics slots, taken at construction
+		int										_metricsId;
+		std::map<const LocationConfig*, int>	_metricsRoutes;
+		int										_metricsUnrouted; // requests no location matched
 		
 		// methods
 		int										setNonBlocking(int fd);
 		void									initSocketId(struct sockaddr_in &socketId, int port);
-		std::string 							selectMethod(const char* buffer, int port, bool);
+		void									tuneListener(int serverSocketFd, int port);
+		void									tuneClient(int clientSocketFd, int port);
+		std::string 							selectMethod(Client* client, int port);
 		void									sendErrorAndCloseClient(int clientSocketFd, const std::string &errorResponse, int port);
 		int										handleReadEvent(Client *client, int clientPort);
 		int										handleWriteEvent(Client *client);
-		void									switchToWriteMode(int clientSocketFd);
-		void									switchToReadMode(int clientSocketFd);
+		void									switchToWriteMode(Client* client);
+		void									switchToReadMode(Client* client);
+		void									watchClient(Client* client, uint32_t events);
+		void									respond(Client* client, const std::string& response, BodyStream* stream = NULL);
+		bool									compressResponse(const Client* client, const std::string& response, BodyStream*& stream, std::string& compressed);
+		int										sendFileRange(Client* client);
+		int										finishResponse(Client* client);
+		void									logAccess(const Client* client);
+		void									recordRequest(const Client* client);
+		void									respondWithError(Client* client, const std::string& errorResponse, int clientPort);
+		void									suspendClient(Client* client);
+		void									finishCgi(CgiProcess* cgi);
+		void									closeCgiInput(CgiProcess* cgi);
+		void									killCgi(CgiProcess* cgi);
+		void									reapCgiZombies();
 		// Prevent Copying
 		Server(const Server& other);
 		Server&									operator=(const Server& other);
 		
 	public:
 		// Generic
-		Server(std::vector<int>ports, std::string host, std::string root, std::vector<std::string> serverName, size_t clientBodyLimit, std::map<int, std::string> errorPages, std::map<std::string, LocationConfig> locations, WebServer* webserver);
+		Server(std::vector<int>ports, std::string host, std::string root, std::vector<std::string> serverName, size_t clientBodyLimit, std::map<int, std::string> errorPages, std::map<std::string, LocationConfig> locations, GzipConfig gzip, MimeConfig mime, SocketConfig sockets, HeaderConfig headers, AccessLogConfig accessLog, WebServer* webserver);
 		~Server();
 		// methods
 		void									run();
@@ -82,21 +123,46 @@ class Server
 		int										treatMethod(struct epoll_event &event, int clientPort);
 		bool									isServerSocket(int fd);
 		const LocationConfig*					matchLocation(std::string& path);
+		const LocationConfig*					matchLocation(const char* path, size_t length);
 		// request handling
 		void									handleReadHeaders(Client* client);
 		void									handleReadBody(Client* client);
+		void									writeUpload(Client* client, size_t bodyStart);
+		void									resumeUpload(IoTask* task, MultipartParser* parser);
 		void									handleReadyToRespond(Client* client, char* buffer, int clientPort);
+		void									dispatchRequest(Client* client, int clientPort);
+		// CGI and request coalescing
+		bool									isCgiPipe(int fd);
+		void									startCgi(CgiProcess* cgi, Client* client);
+		void									handleCgiEvent(int fd);
+		void									checkCgiTimeouts();
+		bool									joinFlight(const std::string& key, Client* client);
+		// blocking filesystem work
+		void									offload(IoTask* task, Client* client);
+		void									finishIo(IoTask* task);
 		// request parser
 		void									parseRequestHeaders(Client* client);
 		void									parseContentLength(const std::string& request, Client* client);
 		void									parseKeepAlive(const std::string& request, Client* client);
+		void									prepareMultipartUpload(Client* client);
+		// metrics
+		Metrics&								getMetrics();
+		void									countCache(MetricsCache cache, bool hit);
+		std::string								renderMetrics();
+		int										getMetricsId() const;
+		size_t									getClientCount() const;
+		size_t									getIdleClientCount() const;
 		// getters
 		int										getPort() const;
 		std::vector<int>						getServerSocketFds() const;
 		int										getClientPort(int clientSocketFd);
+		Client*									findClient(int clientSocketFd, unsigned long clientId);
 		std::vector<int>						getRunningPorts() const;
 		std::map<int, std::string>				getErrorPages() const;
 		ssize_t									getClientBodyLimit() const;
+		int										getEventBatch() const;
+		const MimeTypes&						getMimeTypes() const;
+		CgiCache&								getCgiCache();
 		// setters
 		void									setEpollFd(int epollFd);
 };
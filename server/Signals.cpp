@@ -2,19 +2,34 @@
 #include <iostream>
 
 volatile sig_atomic_t SignalHandler::_shutdown = 0;
+volatile sig_atomic_t SignalHandler::_reload = 0;
 
 void	SignalHandler::signalHandler(int signum) {
 	if (signum == SIGTERM || signum == SIGQUIT || signum == SIGINT) {
 		_shutdown = 1;
 	}
+	else if (signum == SIGHUP)
+		_reload = 1;
 }
 
 void	SignalHandler::setupSignals() {
 	signal(SIGTERM, signalHandler);
 	signal(SIGQUIT, signalHandler);
 	signal(SIGINT, signalHandler);
+	// SIGHUP re-reads log_level from the configuration file
+	signal(SIGHUP, signalHandler);
+	// a CGI that exits without reading its whole body must not kill the server
+	signal(SIGPIPE, SIG_IGN);
 }
 
 bool	SignalHandler::shouldShutdown() {
 	return _shutdown != 0;
 }
+
+// True once per SIGHUP
+bool	SignalHandler::takeReload() {
+	if (_reload == 0)
+		return false;
+	_reload = 0;
+	return true;
+}
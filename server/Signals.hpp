@@ -6,11 +6,13 @@
 class SignalHandler {
 private:
 	static volatile sig_atomic_t	_shutdown;
+	static volatile sig_atomic_t	_reload;
 	static void						signalHandler(int signum);
 
 public:
 	static void						setupSignals();
 	static bool						shouldShutdown();
+	static bool						takeReload();
 };
 
 #endif
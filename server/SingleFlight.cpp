@@ -0,0 +1,41 @@
+#include "SingleFlight.hpp"
+
+SingleFlight::SingleFlight()
+{
+}
+
+SingleFlight::~SingleFlight()
+{
+}
+
+bool	SingleFlight::inFlight(const std::string& key) const
+{
+	return (_flights.find(key) != _flights.end());
+}
+
+void	SingleFlight::start(const std::string& key)
+{
+	_flights[key];
+}
+
+void	SingleFlight::join(const std::string& key, int clientFd, unsigned long clientId)
+{
+	_flights[key].push_back(std::make_pair(clientFd, clientId));
+}
+
+// Ends the flight and hands back everyone who was waiting on it
+std::vector<SingleFlight::Waiter>	SingleFlight::land(const std::string& key)
+{
+	std::vector<Waiter> waiters;
+	std::map<std::string, std::vector<Waiter> >::iterator it = _flights.find(key);
+	if (it == _flights.end())
+		return (waiters);
+	waiters.swap(it->second);
+	_flights.erase(it);
+	return (waiters);
+}
+
+size_t	SingleFlight::size() const
+{
+	return (_flights.size());
+}
@@ -0,0 +1,35 @@
+#ifndef SINGLEFLIGHT_HPP
+#define SINGLEFLIGHT_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+/*
+*	Request coalescing: the first request for a key does the work, every
+*	identical request arriving while it runs is parked here as a waiter
+*	and answered from the same result once the flight lands.
+*	Waiters are (client fd, client id) so a reused fd is never mistaken
+*	for the client that was waiting.
+*/
+class SingleFlight
+{
+	public:
+		typedef std::pair<int, unsigned long>	Waiter;
+
+	private:
+		std::map<std::string, std::vector<Waiter> >	_flights;
+
+	public:
+		SingleFlight();
+		~SingleFlight();
+
+		bool				inFlight(const std::string& key) const;
+		void				start(const std::string& key);
+		void				join(const std::string& key, int clientFd, unsigned long clientId);
+		std::vector<Waiter>	land(const std::string& key);
+		size_t				size() const;
+};
+
+#endif
@@ -12,60 +12,70 @@
 
 #include "WebServer.hpp"
 #include "Server.hpp"
+#include "FsTask.hpp"
 #include "../misc/Evaluator.hpp"
 
-WebServer::WebServer(Config& configFile)
+WebServer::WebServer(Config& configFile) : _configFile(configFile.getFilename())
 {
-	logs::msg(NOPORT, logs::Blue, "Creating WebServer object", true);
+	LOG_MSG(logs::Debug, NOPORT, logs::Blue, "Creating WebServer object");
 	Evaluator evaluator;
 	initServers(configFile);
 }
 
 WebServer::~WebServer()
 {
+	_ioPool.stop();
 	for (size_t i = 0; i < _servers.size(); i++)
 	{
 		delete _servers[i];
 	}
 	_servers.clear();
-	for (std::map<int, Server*>::iterator it = _fdsToServer.begin(); it != _fdsToServer.end(); ++it) {
-		close(it->first);
-	}
+	// every fd in the map belongs to a server, which has closed it
 	_fdsToServer.clear();
+	Arena::releaseSpare();
+	FsTask::releaseSpare();
 }
 
 void	WebServer::shutdown()
 {
-	logs::msg(NOPORT, logs::Blue, "Initiating shutdown...", true);
+	LOG_MSG(logs::Info, NOPORT, logs::Blue, "Initiating shutdown...");
+	_ioPool.stop();
 	for (size_t i = 0; i < _servers.size(); i++)
 	{
 		if (_servers[i])
 			_servers[i]->shutdown();
 	}
-	for (std::map<int, Server*>::iterator it = _fdsToServer.begin(); it != _fdsToServer.end(); ++it) {
-		close(it->first);
-	}
+	_accessLog.stop();
+	// every fd in the map belongs to a server, which has closed it
 	_fdsToServer.clear();
-	logs::msg(NOPORT, logs::Green, "Shutdown completed.", true);
+	LOG_MSG(logs::Info, NOPORT, logs::Green, "Shutdown completed.");
 }
 
 void	WebServer::initServers(Config &config)
 {
 	for (size_t i = 0; i < config._servers.size(); i++)
 	{
-		_servers.push_back(new Server(config._servers[i]._port, config._servers[i]._host, config._servers[i]._root, config._servers[i]._serverName, config._servers[i]._clientBodyLimit, config._servers[i]._errorPages, config._servers[i]._locations, this));
+		_servers.push_back(new Server(config._servers[i]._port, config._servers[i]._host, config._servers[i]._root, config._servers[i]._serverName, config._servers[i]._clientBodyLimit, config._servers[i]._errorPages, config._servers[i]._locations, config._servers[i]._gzip, config._servers[i]._mime, config._servers[i]._sockets, config._servers[i]._headers, config._servers[i]._accessLog, this));
 	}
 }
 
 
 void	WebServer::start()
 {
-	logs::msg(NOPORT, logs::Blue, "Starting WebServer", true);
+	LOG_MSG(logs::Info, NOPORT, logs::Blue, "Starting WebServer");
 	// Create the servers
 	int sharedEpollFd = epoll_create1(0);
 	if (sharedEpollFd == -1)
 	{
-		CERR_MSG("____", "Failed to create epoll fd");
+		LOG_ERR(logs::Error, "____", "Failed to create epoll fd");
+		return;
+	}
+	try {
+		_ioPool.start(sharedEpollFd, IO_POOL_THREADS);
+	} catch (const std::runtime_error& e) {
+		LOG_ERR(logs::Error, "____", e.what());
+		_ioPool.stop();
+		close(sharedEpollFd);
 		return;
 	}
 	for ( size_t i = 0; i < _servers.size(); i++ )
@@ -77,7 +87,7 @@ void	WebServer::start()
 		}
 		catch (const std::runtime_error& e)
 		{
-			logs::msg(NOPORT, logs::Red, e.what(), true);
+			LOG_MSG(logs::Error, NOPORT, logs::Red, e.what());
 			continue;
 		}
 		const std::vector<int>& serverFds = _servers[i]->getServerSocketFds();
@@ -96,34 +106,58 @@ void	WebServer::start()
 	}
 	if (!hasRunningPorts)
 	{
-		CERR_MSG("____", "No server created");
+		LOG_ERR(logs::Error, "____", "No server created");
 		close(sharedEpollFd);
 		return;
 	}
+	try {
+		_accessLog.start();
+	} catch (const std::runtime_error& e) {
+		CERR_MSG("____", e.what());
+	}
+	if (!uploads::loadIndex())
+		CERR_MSG("____", "Upload directory " UPLOAD_PATH " is not readable, the upload index starts empty");
 	evenLoop(sharedEpollFd);
 }
 
 void	WebServer::evenLoop(int sharedEpollFd)
 {
-	struct epoll_event events[MAX_QUEUE];
+	// every server shares this loop, so the largest event_batch wins
+	size_t batch = 1;
+	for (size_t i = 0; i < _servers.size(); i++)
+		batch = std::max(batch, static_cast<size_t>(_servers[i]->getEventBatch()));
+	std::vector<struct epoll_event> events(batch);
 	try {
 		while (!SignalHandler::shouldShutdown())
 		{
-			int numEvents = epoll_wait(sharedEpollFd, events, MAX_QUEUE, 2000);
+			int numEvents = epoll_wait(sharedEpollFd, &events[0], static_cast<int>(batch), 2000);
 			
 			if (SignalHandler::shouldShutdown())
 				break;
+			if (SignalHandler::takeReload())
+				reloadLogLevel();
+			if (numEvents == -1 && errno == EINTR)
+				continue;
 			if (numEvents == -1)
 				THROW_MSG("____", "Epoll wait failed");
+			for (size_t i = 0; i < _servers.size(); i++)
+				_servers[i]->checkCgiTimeouts();
 			if (numEvents == 0)
 				continue;
 			for (int i = 0; i < numEvents; i++)
 			{
+				if (events[i].data.fd == _ioPool.getEventFd())
+				{
+					_ioPool.drain();
+					continue;
+				}
 				Server* server = _fdsToServer[events[i].data.fd];
 				if (server == NULL)
 					continue;
 				if (server->isServerSocket(events[i].data.fd))
 					server->acceptClient(events[i].data.fd);
+				else if (server->isCgiPipe(events[i].data.fd))
+					server->handleCgiEvent(events[i].data.fd);
 				else
 				{
 					int clientPort = server->getClientPort(events[i].data.fd);
@@ -145,12 +179,28 @@ void	WebServer::evenLoop(int sharedEpollFd)
 	}
 	catch (const std::exception& e)
 	{
-		logs::msg(NOPORT, logs::Red, e.what(), true);
+		LOG_MSG(logs::Error, NOPORT, logs::Red, e.what());
 	}
 	shutdown();
 	close(sharedEpollFd);
 }
 
+// SIGHUP: only log_level is taken from the file, the rest needs a restart
+void	WebServer::reloadLogLevel()
+{
+	Config config;
+	try {
+		config.parseFile(_configFile);
+	} catch (const std::exception& e) {
+		LOG_ERR(logs::Error, "____", std::string("Reload failed, log level unchanged: ") + e.what());
+		return;
+	}
+	logs::Level level;
+	if (logs::parseLevel(config.getLogLevel(), level))
+		logs::threshold = level;
+	LOG_MSG(logs::Warn, NOPORT, logs::Blue, std::string("Log level is now ") + logs::levelName(logs::threshold));
+}
+
 void	WebServer::registerClientFd(int fd, Server* server)
 {
 	_fdsToServer[fd] = server;
@@ -160,3 +210,36 @@ void	WebServer::unregisterClientFd(int fd)
 {
 	_fdsToServer.erase(fd);
 }
+
+IoPool&	WebServer::getIoPool()
+{
+	return (_ioPool);
+}
+
+GzipPool&	WebServer::getGzipPool()
+{
+	return (_gzipPool);
+}
+
+AccessLog&	WebServer::getAccessLog()
+{
+	return (_accessLog);
+}
+
+Metrics&	WebServer::getMetrics()
+{
+	return (_metrics);
+}
+
+// Connection gauges are read from the servers, everything else from the shards
+std::string	WebServer::renderMetrics()
+{
+	std::vector<size_t> active(METRICS_SERVERS, 0);
+	std::vector<size_t> idle(METRICS_SERVERS, 0);
+	for (size_t i = 0; i < _servers.size(); i++)
+	{
+		active[_servers[i]->getMetricsId()] += _servers[i]->getClientCount();
+		idle[_servers[i]->getMetricsId()] += _servers[i]->getIdleClientCount();
+	}
+	return (_metrics.render(active, idle));
+}
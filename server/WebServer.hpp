@@ -17,6 +17,10 @@
 
 #include "utils.hpp"
 #include "Signals.hpp"
+#include "IoPool.hpp"
+#include "Gzip.hpp"
+#include "AccessLog.hpp"
+#include "Metrics.hpp"
 #include "../parse/Config.hpp"
 #include <vector>
 #include <iostream>
@@ -26,8 +30,8 @@
 #include <cstdlib>
 #include <sys/epoll.h>
 #include <map>
-#define MAX_QUEUE 10
-#define CERR_MSG(port, msg) std::cerr << "\e[31m[" + to_string(port) + "]\e[0m\t" + "\e[2m" + msg + "\e[0m" << std::endl
+#include <algorithm>
+#include <cerrno>
 #define THROW_MSG(port, msg) throw std::runtime_error("\e[31m[" + to_string(port) + "]\e[0m\t" + "\e[2m" + msg + "\e[0m")
 
 class Server;
@@ -37,6 +41,11 @@ class WebServer
 	private:
 		std::vector<Server *>	_servers;
 		std::map<int, Server *>	_fdsToServer;
+		IoPool					_ioPool;
+		GzipPool				_gzipPool;
+		AccessLog				_accessLog;
+		Metrics					_metrics;
+		std::string				_configFile;
 	public:
 		// Generic
 		WebServer(Config &);
@@ -46,8 +55,14 @@ class WebServer
 		void					shutdown();
 		void					initServers(Config &config);
 		void					evenLoop(int sharedEpollFd);
+		void					reloadLogLevel();
 		void					registerClientFd(int fd, Server* server);
 		void					unregisterClientFd(int fd);
+		IoPool&					getIoPool();
+		GzipPool&				getGzipPool();
+		AccessLog&				getAccessLog();
+		Metrics&				getMetrics();
+		std::string				renderMetrics();
 };
 
 #endif
@@ -2,19 +2,19 @@
 
 void cookies::cookTheCookies(char buffer[], Client *client)
 {
-	std::string request(buffer);
 	if (client->getIsRegisteredCookies())
 		return ;
-	if (request.find("GET") == std::string::npos)
+	// looked up in place: most requests carry no cookie to copy
+	if (!std::strstr(buffer, "GET") || !std::strstr(buffer, "Cookie: "))
 		return ;
-	if (!parseCookieHeader(request, client))
+	if (!parseCookieHeader(buffer, client))
 		return ;
 	if (!checkCookies(client->getCookies()))
 		throw std::runtime_error(ERROR_400_RESPONSE);
 	client->setRegistered(true);
 }
 
-bool	cookies::parseCookieHeader(std::string request, Client *client)
+bool	cookies::parseCookieHeader(const std::string& request, Client *client)
 {
 	std::map<std::string, std::string> cookies;
 	size_t pos = request.find("Cookie: ");
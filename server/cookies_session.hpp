@@ -10,7 +10,7 @@
 namespace cookies
 {
 	void		cookTheCookies(char buffer[], Client *client);
-	bool		parseCookieHeader(std::string request, Client *client);
+	bool		parseCookieHeader(const std::string& request, Client *client);
 	bool		checkCookies(std::map<std::string, std::string> cookies);
 	std::string	generateCookieId();
 }
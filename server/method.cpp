@@ -1,7 +1,8 @@
 #include "cookies_session.hpp"
 #include "method.hpp"
+#include "FsTask.hpp"
 
-std::string method::GET(const std::string& request, int port, Server& server, bool isRegistered)
+std::string method::GET(const std::string& request, int port, Server& server, Client *client)
 {
 	size_t start = request.find("GET") + 4;
 	size_t end = request.find(" ", start);
@@ -10,48 +11,51 @@ std::string method::GET(const std::string& request, int port, Server& server, bo
 	if (request.find("GET /register") != std::string::npos)
 		return (POST_303_RESPONSE("/index.html", true));
 
-	std::string fullPath = request.substr(start, end - start);
-	std::string path = fullPath;
+	// target and path are slices of the request buffer, routing temporaries
+	// come from the request arena; only what a task keeps is copied out
+	Arena& arena = client->getArena();
+	const char* target = request.data() + start;
+	size_t targetLength = end - start;
+	const char* query = static_cast<const char *>(std::memchr(target, '?', targetLength));
+	const char* path = target;
+	size_t pathLength = query ? static_cast<size_t>(query - target) : targetLength;
 	
-	size_t questionMarkPos = fullPath.find('?');
-	if (questionMarkPos != std::string::npos) {
-		path = fullPath.substr(0, questionMarkPos);
-	}
-	
-	const LocationConfig* location = server.matchLocation(path);
+	const LocationConfig* location = server.matchLocation(path, pathLength);
 	if (!location)
 		throw std::runtime_error(ERROR_404_RESPONSE);
 
 	if (checkPermissions("GET", location) == false)
 		throw std::runtime_error(ERROR_403_RESPONSE);
+	if (location->getLocationMetrics())
+		return (server.renderMetrics());
 
-	std::string locationName = location->getLocationName();
-	std::string locationRoot = location->getLocationRoot();
-	std::string locationIndex = location->getLocationIndex();
+	const std::string& locationName = location->getLocationName();
+	const std::string& locationRoot = location->getLocationRoot();
+	const std::string& locationIndex = location->getLocationIndex();
+	const char* filePath = arena.join(locationRoot.data(), locationRoot.size(), locationIndex.data(), locationIndex.size());
 
 	if (!locationRoot.empty() && !locationIndex.empty())
 	{
-		std::string filePath = locationRoot + locationIndex;
 		// Check if it's a CGI script
 		if (isCGIScript(filePath))
-			return (handleCGI(request, filePath, port));
+			return (handleCGI(request, filePath, port, server, location, client));
 	}
 
 	if (locationName != "/" && locationName[locationName.length() - 1] == '/') 
 	{
 		if (location->getLocationAutoIndex())
 		{
-			if (path[path.length() - 1] != '/')
+			if (pathLength == 0 || path[pathLength - 1] != '/')
 			{
-				size_t pos = path.find_last_of("/");
-				std::string lastPath;
-				if (pos != std::string::npos)
-					lastPath = locationRoot + path.substr(pos + 1);
-				else
+				const char* slash = static_cast<const char *>(memrchr(path, '/', pathLength));
+				if (!slash)
 					throw std::runtime_error(ERROR_404_RESPONSE);
-				return (method::foundPage(lastPath, isRegistered));
+				const char* lastPath = arena.join(locationRoot.data(), locationRoot.size(), slash + 1, path + pathLength - slash - 1);
+				server.offload(FsTask::create(FsTask::READ_PAGE, server, client, lastPath, std::strlen(lastPath), location), client);
+				return ("");
 			}
-			return (generateAutoIndexPage(location, isRegistered));
+			server.offload(FsTask::create(FsTask::AUTOINDEX, server, client, target, targetLength, location), client);
+			return ("");
 		}
 		else 
 		{
@@ -61,40 +65,368 @@ std::string method::GET(const std::string& request, int port, Server& server, bo
 
 	if (locationRoot.empty() || locationIndex.empty())
 		throw std::runtime_error(ERROR_500_RESPONSE);
-	std::string filePath = locationRoot + locationIndex;
-	if (!filePath.empty())
-		return (method::foundPage(filePath, isRegistered));
+	if (std::strcmp(filePath, "./www/methods.html") == 0)
+		server.offload(FsTask::create(FsTask::METHODS_PAGE, server, client, getQueryParam(std::string(target, targetLength), "cursor")), client);
 	else
-		throw std::runtime_error(ERROR_404_RESPONSE);
+		server.offload(FsTask::create(FsTask::READ_PAGE, server, client, filePath, std::strlen(filePath), location), client);
+	return ("");
 }
 
-std::string method::foundPage(const std::string& filepath, bool isRegistered)
+/*
+*	Static pages carry a strong ETag and Last-Modified taken from the file
+*	metadata, so a revalidation is answered with a 304 after a single stat.
+*	The head is written into response, the task's own buffer; paths and
+*	validators stay on the stack, so serving a file allocates nothing more.
+*/
+void method::foundPage(const std::string& filepath, const std::string& contentType, bool isRegistered, const std::string& request, BodyStream*& stream, bool gzipStatic, std::string& response)
 {
-	std::ifstream	file(filepath.c_str());
-	if (file.is_open())
+	struct stat info;
+	if (stat(filepath.c_str(), &info) == -1 || !S_ISREG(info.st_mode))
+		throw std::runtime_error(ERROR_404_RESPONSE);
+	if (filepath == "./www/methods.html")
+	{
+		response = generateMethodsPage(isRegistered);
+		return ;
+	}
+	// gnl adds the register link to pages sent to unregistered visitors
+	bool withRegisterLink = contentType == "text/html" && !isRegistered;
+	char sidecar[PATH_MAX];
+	const char* path = filepath.c_str();
+	const char* coding = NULL;
+	if (gzipStatic && !withRegisterLink)
 	{
-		std::string	textType;
-		if (filepath == "./www/methods.html")
-			return (generateMethodsPage(isRegistered));
+		size_t length;
+		const char* acceptEncoding = findHeaderValue(request, "Accept-Encoding", length);
+		if (acceptEncoding)
+			coding = findSidecar(filepath, info, acceptEncoding, length, sidecar, sizeof(sidecar));
+		if (coding)
+			path = sidecar;
+	}
+	char etag[ETAG_MAX];
+	char validators[VALIDATORS_MAX];
+	makeETag(info, withRegisterLink, etag);
+	makeValidators(validators, gzipStatic, coding, etag, info.st_mtime);
+	if (isNotModified(request, etag, info.st_mtime))
+	{
+		response = "HTTP/1.1 304 Not Modified\r\n";
+		response += validators;
+		response += "\r\n";
+		return ;
+	}
+
+	if (withRegisterLink)
+	{
+		std::ifstream	file(filepath.c_str());
+		if (!file.is_open())
+			throw std::runtime_error(ERROR_404_RESPONSE);
 		std::string	content = gnl(file, isRegistered);
-		if (filepath.find(".css") != std::string::npos)
-			textType = "css";
-		else if (filepath.find(".txt") != std::string::npos)
-			textType = "txt";
-		else if (filepath.find(".html") != std::string::npos)
-			textType = "html";
-		else if (filepath.find(".ico") != std::string::npos)
-			textType = "ico";
-		else 
-			throw std::runtime_error(ERROR_400_RESPONSE);
-		return (
-			"HTTP/1.1 200 OK\r\n"
-			"Content-Type: text/" + textType + "\r\n"
-			"Content-Length: " + to_string(content.length()) + "\r\n"
-			"\r\n" + content);
+		rangedResponse(response, request, contentType, validators, etag, info.st_mtime,
+			content.length(), &content, NULL);
+		return ;
 	}
-	else
+	// anything else goes out byte for byte, from the page cache to the socket
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		throw std::runtime_error(ERROR_404_RESPONSE);
+	FileBody* body = new FileBody(fd);
+	struct stat opened;
+	if (fstat(fd, &opened) == -1 || !S_ISREG(opened.st_mode))
+	{
+		delete body;
 		throw std::runtime_error(ERROR_404_RESPONSE);
+	}
+	// the file may have changed since the stat
+	if (opened.st_ino != info.st_ino || opened.st_size != info.st_size
+		|| opened.st_mtim.tv_sec != info.st_mtim.tv_sec || opened.st_mtim.tv_nsec != info.st_mtim.tv_nsec)
+	{
+		info = opened;
+		makeETag(info, false, etag);
+		makeValidators(validators, gzipStatic, coding, etag, info.st_mtime);
+	}
+	rangedResponse(response, request, contentType, validators, etag, info.st_mtime,
+		info.st_size, NULL, body);
+	if (body->empty())
+		delete body;
+	else
+		stream = body;
+}
+
+/*
+*	gzip_static: a precompressed copy next to the file (file.br, file.gz)
+*	is sent in its place when the client accepts that encoding. A copy
+*	older than the file is stale and ignored. On success path and info
+*	describe the copy and the content coding is returned, NULL otherwise.
+*/
+const char* method::findSidecar(const std::string& filepath, struct stat& info, const char* acceptEncoding, size_t length, char* path, size_t size)
+{
+	static const char* codings[][2] = {{"br", ".br"}, {"gzip", ".gz"}};
+	for (size_t i = 0; i < sizeof(codings) / sizeof(codings[0]); i++)
+	{
+		struct stat sidecar;
+		if (acceptsEncoding(acceptEncoding, length, codings[i][0])
+			&& static_cast<size_t>(std::snprintf(path, size, "%s%s", filepath.c_str(), codings[i][1])) < size
+			&& stat(path, &sidecar) == 0 && S_ISREG(sidecar.st_mode)
+			&& sidecar.st_mtime >= info.st_mtime)
+		{
+			info = sidecar;
+			return (codings[i][0]);
+		}
+	}
+	return (NULL);
+}
+
+// Accept-Encoding lists codings with an optional weight; q=0 refuses one,
+// and an explicit entry wins over "*". Read in place from the request.
+bool method::acceptsEncoding(const char* acceptEncoding, size_t length, const char* coding)
+{
+	const char* end = acceptEncoding + length;
+	int wildcard = -1;
+	for (const char* item = acceptEncoding; item < end;)
+	{
+		const char* itemEnd = static_cast<const char *>(std::memchr(item, ',', end - item));
+		if (!itemEnd)
+			itemEnd = end;
+		const char* semicolon = static_cast<const char *>(std::memchr(item, ';', itemEnd - item));
+		const char* name = item;
+		const char* nameEnd = semicolon ? semicolon : itemEnd;
+		item = itemEnd + 1;
+		while (name < nameEnd && (*name == ' ' || *name == '\t'))
+			name++;
+		while (nameEnd > name && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t'))
+			nameEnd--;
+		if (name == nameEnd)
+			continue;
+		bool accepted = true;
+		for (const char* q = semicolon; q && q + 1 < itemEnd; q++)
+		{
+			if (q[0] == 'q' && q[1] == '=')
+			{
+				accepted = std::strtod(q + 2, NULL) > 0;
+				break;
+			}
+		}
+		size_t nameLength = nameEnd - name;
+		if (std::strlen(coding) == nameLength && strncasecmp(name, coding, nameLength) == 0)
+			return (accepted);
+		if (nameLength == 1 && *name == '*')
+			wildcard = accepted;
+	}
+	return (wildcard == 1);
+}
+
+/*
+*	200 with the whole representation, 206 with the byte ranges asked for
+*	(one range, or several as multipart/byteranges) or 416 when none of them
+*	overlaps it. The body is taken from content, or added to body as file
+*	ranges so that a seek into a large file only sends the bytes requested;
+*	response then holds the head and the body follows it.
+*/
+void method::rangedResponse(std::string& response, const std::string& request, const std::string& contentType,
+	const char* headers, const char* etag, time_t mtime, off_t length,
+	const std::string* content, FileBody* body)
+{
+	std::vector<std::pair<off_t, off_t> > ranges;
+	if (!selectRanges(request, etag, mtime, length, ranges))
+	{
+		response = "HTTP/1.1 200 OK\r\nContent-Type: ";
+		response += contentType;
+		response += "\r\nContent-Length: ";
+		appendNumber(response, length);
+		response += "\r\nAccept-Ranges: bytes\r\n";
+		response += headers;
+		response += "\r\n";
+		if (body)
+			body->addRange(0, length);
+		else
+			response += *content;
+		return ;
+	}
+	if (ranges.empty())
+	{
+		response = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */";
+		appendNumber(response, length);
+		response += "\r\nContent-Length: 0\r\nAccept-Ranges: bytes\r\n";
+		response += headers;
+		response += "\r\n";
+		return ;
+	}
+	if (ranges.size() == 1)
+	{
+		response = "HTTP/1.1 206 Partial Content\r\nContent-Type: ";
+		response += contentType;
+		response += "\r\nContent-Range: bytes ";
+		appendNumber(response, ranges[0].first);
+		response += "-";
+		appendNumber(response, ranges[0].first + ranges[0].second - 1);
+		response += "/";
+		appendNumber(response, length);
+		response += "\r\nContent-Length: ";
+		appendNumber(response, ranges[0].second);
+		response += "\r\nAccept-Ranges: bytes\r\n";
+		response += headers;
+		response += "\r\n";
+		if (body)
+			body->addRange(ranges[0].first, ranges[0].second);
+		else
+			response.append(*content, ranges[0].first, ranges[0].second);
+		return ;
+	}
+	static unsigned long boundaries = 0;
+	std::ostringstream boundary;
+	boundary << std::hex << "byteranges_" << time(0) << "_" << __sync_add_and_fetch(&boundaries, 1);
+	std::vector<std::string> partHeads;
+	off_t total = 0;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		partHeads.push_back("\r\n--" + boundary.str() + "\r\n"
+			"Content-Type: " + contentType + "\r\n"
+			"Content-Range: bytes " + to_string(ranges[i].first) + "-"
+				+ to_string(ranges[i].first + ranges[i].second - 1) + "/" + to_string(length) + "\r\n"
+			"\r\n");
+		total += partHeads[i].size() + ranges[i].second;
+	}
+	std::string tail = "\r\n--" + boundary.str() + "--\r\n";
+	total += tail.size();
+	response = "HTTP/1.1 206 Partial Content\r\n"
+		"Content-Type: multipart/byteranges; boundary=" + boundary.str() + "\r\n"
+		"Content-Length: " + to_string(total) + "\r\n"
+		"Accept-Ranges: bytes\r\n" + headers + "\r\n";
+	std::string out;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		out += partHeads[i];
+		if (body)
+		{
+			body->addText(out);
+			body->addRange(ranges[i].first, ranges[i].second);
+			out.clear();
+		}
+		else
+			out.append(*content, ranges[i].first, ranges[i].second);
+	}
+	out += tail;
+	if (body)
+		body->addText(out);
+	else
+		response += out;
+}
+
+/*
+*	Resolves a Range header into (offset, length) pairs. Returns false when
+*	the whole representation must be sent: no Range, a failed If-Range, a
+*	header we cannot parse or too many ranges. Ranges past the end are
+*	dropped, so true with no range left means 416.
+*/
+bool method::selectRanges(const std::string& request, const char* etag, time_t mtime, off_t length,
+	std::vector<std::pair<off_t, off_t> >& ranges)
+{
+	std::string range = getHeaderValue(request, "Range");
+	if (range.compare(0, 6, "bytes=") != 0)
+		return (false);
+	std::string ifRange = getHeaderValue(request, "If-Range");
+	if (!ifRange.empty())
+	{
+		time_t date;
+		if (ifRange[0] == '"' ? ifRange != etag : !parseHttpDate(ifRange, date) || date != mtime)
+			return (false);
+	}
+	std::istringstream specs(range.substr(6));
+	std::string spec;
+	size_t count = 0;
+	while (std::getline(specs, spec, ','))
+	{
+		size_t begin = spec.find_first_not_of(" \t");
+		size_t end = spec.find_last_not_of(" \t");
+		if (begin == std::string::npos || ++count > RANGE_MAX)
+			return (false);
+		spec = spec.substr(begin, end + 1 - begin);
+		size_t dash = spec.find('-');
+		if (dash == std::string::npos)
+			return (false);
+		off_t first, last;
+		bool hasFirst = parseOffset(spec.substr(0, dash), first);
+		bool hasLast = parseOffset(spec.substr(dash + 1), last);
+		if ((!hasFirst && dash != 0) || (!hasLast && dash + 1 != spec.size()) || (!hasFirst && !hasLast))
+			return (false);
+		if (!hasFirst) // suffix: the last bytes
+		{
+			if (last == 0 || length == 0)
+				continue;
+			first = last < length ? length - last : 0;
+			last = length - 1;
+		}
+		else if (!hasLast || last >= length)
+			last = length - 1;
+		else if (last < first)
+			return (false);
+		if (first < length)
+			ranges.push_back(std::make_pair(first, last - first + 1));
+	}
+	return (true);
+}
+
+// Decimal offset; huge values saturate instead of overflowing
+bool method::parseOffset(const std::string& str, off_t& offset)
+{
+	if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+		return (false);
+	offset = 0;
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		if (offset > RANGE_OFFSET_MAX / 10)
+		{
+			offset = RANGE_OFFSET_MAX;
+			return (true);
+		}
+		offset = offset * 10 + (str[i] - '0');
+	}
+	return (true);
+}
+
+// "inode-size-mtime", plus a suffix for the variant with the register link
+void method::makeETag(const struct stat& info, bool withRegisterLink, char* etag)
+{
+	std::snprintf(etag, ETAG_MAX, "\"%lx-%lx-%lx.%lx%s\"", static_cast<unsigned long>(info.st_ino),
+		static_cast<unsigned long>(info.st_size), static_cast<unsigned long>(info.st_mtim.tv_sec),
+		static_cast<unsigned long>(info.st_mtim.tv_nsec), withRegisterLink ? "-r" : "");
+}
+
+// Content-Encoding and Vary for gzip_static, then ETag and Last-Modified
+void method::makeValidators(char* validators, bool vary, const char* coding, const char* etag, time_t mtime)
+{
+	char date[64];
+	httpDate(mtime, date, sizeof(date));
+	std::snprintf(validators, VALIDATORS_MAX, "%s%s%s%sETag: %s\r\nLast-Modified: %s\r\n",
+		coding ? "Content-Encoding: " : "", coding ? coding : "", coding ? "\r\n" : "",
+		vary ? "Vary: Accept-Encoding\r\n" : "", etag, date);
+}
+
+// If-None-Match wins over If-Modified-Since when both are sent (RFC 9110)
+bool method::isNotModified(const std::string& request, const char* etag, time_t mtime)
+{
+	size_t length;
+	const char* ifNoneMatch = findHeaderValue(request, "If-None-Match", length);
+	if (ifNoneMatch && length > 0)
+	{
+		if (length == 1 && *ifNoneMatch == '*')
+			return (true);
+		size_t etagLength = std::strlen(etag);
+		const char* end = ifNoneMatch + length;
+		const char* tag = ifNoneMatch;
+		while ((tag = static_cast<const char *>(std::memchr(tag, '"', end - tag))))
+		{
+			const char* close = static_cast<const char *>(std::memchr(tag + 1, '"', end - tag - 1));
+			if (!close)
+				break;
+			if (static_cast<size_t>(close + 1 - tag) == etagLength && std::memcmp(tag, etag, etagLength) == 0)
+				return (true);
+			tag = close + 1;
+		}
+		return (false);
+	}
+	const char* ifModifiedSince = findHeaderValue(request, "If-Modified-Since", length);
+	time_t since;
+	return (ifModifiedSince && length > 0 && parseHttpDate(std::string(ifModifiedSince, length), since) && mtime <= since);
 }
 
 std::string method::getErrorHtml(int port, const std::string& errorMessage, Server &server, bool isRegistered)
@@ -114,7 +446,7 @@ std::string method::getErrorHtml(int port, const std::string& errorMessage, Serv
 	if (errorPages.find(errorCodeInt) != errorPages.end())
 	{
 		std::string errorFilePath = errorPages[errorCodeInt];
-		CERR_MSG(port, "GET Sending error " + errorCode + ": " + errorFilePath);
+		LOG_ERR(logs::Debug, port, "GET Sending error " + errorCode + ": " + errorFilePath);
 		std::ifstream file(errorFilePath.c_str());
 		if (file.is_open())
 		{
@@ -133,18 +465,18 @@ std::string method::getErrorHtml(int port, const std::string& errorMessage, Serv
 		}
 		else
 		{
-			CERR_MSG(port, "GET Sending error " + errorCode + ": sending default 404 fallback page");
+			CERR_MSG(port, "GET Sending error " + errorCode + ": " + errorFilePath + " is unreadable, sending the default page");
 			return (errorMessage);
 		}
 	}
 	else
 	{
-		CERR_MSG(port, "GET Sending error " + errorCode + ": sending default 404 fallback page");
+		LOG_ERR(logs::Debug, port, "GET Sending error " + errorCode + ": sending the default page");
 		return (errorMessage);
 	}
 }
 
-std::string method::POST(const std::string& request, int port, Server &server)
+std::string method::POST(const std::string& request, int port, Server &server, Client *client)
 {
 	size_t start = request.find("POST") + 5;
 	size_t end = request.find(" ", start);
@@ -161,7 +493,7 @@ std::string method::POST(const std::string& request, int port, Server &server)
 	}
 
 	if (request.find("POST /delete") != std::string::npos)
-		return (checkDeleteRequest(request, server));
+		return (checkDeleteRequest(request, server, client));
 
 	const LocationConfig* location = server.matchLocation(pathName);
 	if (!location)
@@ -176,8 +508,8 @@ std::string method::POST(const std::string& request, int port, Server &server)
 	if (!locationRoot.empty() && !locationIndex.empty())
 	{
 		std::string filePath = locationRoot + locationIndex;
-		if (isCGIScript(filePath))
-			return (handleCGI(request, filePath, port));
+		if (isCGIScript(filePath.c_str()))
+			return (handleCGI(request, filePath, port, server, location, client));
 	}
 
 	std::string contentLengthHeader;
@@ -193,56 +525,56 @@ std::string method::POST(const std::string& request, int port, Server &server)
 				throw std::runtime_error(ERROR_413_RESPONSE);
 		}
 	}
+	if (request.find("Content-Type: multipart/form-data") != std::string::npos)
+		return (handleFileUpload(request, server, client));
+	FsTask::Op op = FsTask::WRITE_DASHBOARD;
 	if (request.find("User-Agent: curl") != std::string::npos)
-		return (postFromTerminal(request, server));
-	else if (request.find("Content-Type: multipart/form-data") != std::string::npos)
-		return (handleFileUpload(request, server));
-	else if (request.find("Content-Type: application/x-www-form-urlencoded") != std::string::npos)
-		return (postFromDashboard(request, server));
-	else
-		return (postFromDashboard(request, server));
+		op = FsTask::WRITE_TERMINAL;
+	server.offload(FsTask::create(op, server, client, request), client);
+	return ("");
 }
 
-std::string method::handleFileUpload(const std::string& request, Server& server)
+/*
+*	The body has normally been streamed to disk part by part while it was
+*	received (Server::writeUpload) and only its last bytes are left; a
+*	body that was buffered whole goes through the same parser. Either way
+*	the rest is written and the upload finished on the I/O pool.
+*/
+std::string method::handleFileUpload(const std::string& request, Server& server, Client *client)
 {
-	std::string boundary;
-	size_t boundaryPos = request.find("boundary=");
-	if (boundaryPos != std::string::npos)
-	{
-		size_t lineEnd = request.find("\r\n", boundaryPos);
-		boundary = request.substr(boundaryPos + 9, lineEnd - boundaryPos - 9);
-	}
-	
-	if (boundary.empty())
-		throw std::runtime_error(ERROR_400_RESPONSE);
 	size_t bodyStart = request.find("\r\n\r\n");
 	if (bodyStart == std::string::npos)
 		throw std::runtime_error(ERROR_400_RESPONSE);
-	
-	std::string body = request.substr(bodyStart + 4);
-	if ((ssize_t)body.length() > server.getClientBodyLimit())
-		throw std::runtime_error(ERROR_413_RESPONSE);
-
-	std::string fileName = UPLOAD_PATH + to_string(time(0)) + "_upload.txt";
-	while (std::ifstream(fileName.c_str()))
-		fileName = UPLOAD_PATH + to_string(time(0)) + "_upload.txt";
-	
-	std::ofstream file(fileName.c_str());
-	if (file.is_open())
+	bodyStart += 4;
+	size_t length = request.length() - bodyStart;
+	MultipartParser* parser = client->takeMultipart();
+	if (parser)
+		length = std::min(length, client->getExpectedContentLength() - client->getReceivedContentLength());
+	else
 	{
-		file << "=== File uploaded via multipart/form-data ===" << std::endl;
-		file << "Boundary: " << boundary << std::endl;
-		file << "Content length: " << body.length() << std::endl;
-		file << "=== Raw content ===" << std::endl;
-		file << body;
-		file.close();
-		return (POST_201_RESPONSE);
+		std::string boundary = MultipartParser::extractBoundary(request);
+		if (boundary.empty())
+			throw std::runtime_error(ERROR_400_RESPONSE);
+		if ((ssize_t)length > server.getClientBodyLimit())
+			throw std::runtime_error(ERROR_413_RESPONSE);
+		parser = new MultipartParser(boundary);
 	}
-	else
-		throw std::runtime_error(ERROR_500_RESPONSE);
+	FsTask* task = FsTask::create(FsTask::FINISH_UPLOAD, server, client, request.data() + bodyStart, length);
+	task->setUpload(parser);
+	server.offload(task, client);
+	return ("");
 }
 
-std::string method::checkDeleteRequest(const std::string &request, Server &server)
+// I/O pool side: the last body bytes, then the files are indexed
+std::string method::finishUpload(MultipartParser& parser, const std::string& body)
+{
+	parser.feed(body.data(), body.size());
+	if (!parser.finish())
+		throw std::runtime_error(parser.getIoError() ? ERROR_500_RESPONSE : ERROR_400_RESPONSE);
+	return (POST_201_RESPONSE);
+}
+
+std::string method::checkDeleteRequest(const std::string &request, Server &server, Client *client)
 {
 	std::string lastPart;
 	size_t refererStart = request.find("Referer: ");
@@ -264,17 +596,18 @@ std::string method::checkDeleteRequest(const std::string &request, Server &serve
 		throw std::runtime_error(ERROR_404_RESPONSE);
 	if (checkPermissions("DELETE", location) == false)
 		throw std::runtime_error(ERROR_403_RESPONSE);
-	return (handleDeleteRequest(request));
+	server.offload(FsTask::create(FsTask::DELETE_FORM, server, client, request), client);
+	return ("");
 }
 
-std::string method::postFromTerminal(const std::string &request, Server &server)
+std::string method::postFromTerminal(const std::string &request, ssize_t bodyLimit)
 {
 	std::string body = request.substr(request.find("\r\n\r\n") + 4);
 	if (body.empty())
 		throw std::runtime_error(ERROR_400_RESPONSE);
 
 	ssize_t bytesReceived = body.length();
-	if (bytesReceived > server.getClientBodyLimit())
+	if (bytesReceived > bodyLimit)
 		throw std::runtime_error(ERROR_413_RESPONSE);
 	std::string extension = ".txt";
 	if (request.find("Content-Type: application/json") != std::string::npos)
@@ -284,15 +617,18 @@ std::string method::postFromTerminal(const std::string &request, Server &server)
 	else if (request.find("Content-Type: text/xml") != std::string::npos)
 		extension = ".xml";
 
-	std::string fileName = UPLOAD_PATH + to_string(time(0)) + extension;
-	while (std::ifstream(fileName.c_str()))
-		fileName = UPLOAD_PATH + to_string(time(0)) + extension;
-
-	std::ofstream file(fileName.c_str());
-	if (file.is_open())
+	std::string fileName;
+	int fd = uploads::createUnique("", extension, fileName);
+	if (fd != -1)
 	{
-		file << body;
-		file.close();
+		bool written = writeAll(fd, body.data(), body.length());
+		close(fd);
+		if (!written)
+		{
+			std::remove(fileName.c_str());
+			throw std::runtime_error(ERROR_500_RESPONSE);
+		}
+		uploads::indexFile(fileName);
 		
 		std::string response = 
 			"HTTP/1.1 201 Created\r\n"
@@ -309,10 +645,10 @@ std::string method::postFromTerminal(const std::string &request, Server &server)
 		throw std::runtime_error(ERROR_500_RESPONSE);
 }
 
-std::string method::postFromDashboard(const std::string &request, Server &server)
+std::string method::postFromDashboard(const std::string &request, ssize_t bodyLimit)
 {
 	if (request.find("User-Agent: curl") != std::string::npos)
-		return postFromTerminal(request, server);
+		return postFromTerminal(request, bodyLimit);
 
 	std::string body = request.substr(request.find("\r\n\r\n") + 4);
 	std::string content = "";
@@ -355,15 +691,18 @@ std::string method::postFromDashboard(const std::string &request, Server &server
 			"Location: /methods.html?error=empty\r\n"
 			"\r\n");
 	}
-	std::string fileName = UPLOAD_PATH + to_string(time(0)) + ".txt";
-	while (std::ifstream(fileName.c_str()))
-		fileName = UPLOAD_PATH + to_string(time(0)) + ".txt";
-
-	std::ofstream file(fileName.c_str());
-	if (file.is_open())
+	std::string fileName;
+	int fd = uploads::createUnique("", ".txt", fileName);
+	if (fd != -1)
 	{
-		file << content;
-		file.close();
+		bool written = writeAll(fd, content.data(), content.length());
+		close(fd);
+		if (!written)
+		{
+			std::remove(fileName.c_str());
+			throw std::runtime_error(ERROR_500_RESPONSE);
+		}
+		uploads::indexFile(fileName);
 		return (POST_303_RESPONSE("/methods.html"));
 	}
 	else
@@ -407,13 +746,14 @@ std::string method::deleteTargetFiles(std::vector<std::string>files)
 {
 	for (std::vector<std::string>::iterator it = files.begin(); it != files.end(); ++it)
 	{
-		std::string filePath = UPLOAD_PATH + *it;
+		std::string filePath = uploads::pathOf(*it);
 		std::ifstream file(filePath.c_str());
 		if (!file.is_open())
 			return (ERROR_404_RESPONSE);
 		file.close();
 		if (std::remove(filePath.c_str()) != 0)
 			throw std::runtime_error(ERROR_500_RESPONSE);
+		uploads::unindexFile(filePath);
 	}
 	return (POST_303_RESPONSE("/methods.html"));
 }
@@ -427,7 +767,7 @@ std::string method::trimFileName(std::string str)
 	return (str.substr(start, end - start));
 }
 
-std::string method::DELETE(const std::string& request, Server &server)
+std::string method::DELETE(const std::string& request, Server &server, Client *client)
 {
 	std::string requestPath;
 	size_t start = request.find("DELETE") + 7;
@@ -453,14 +793,22 @@ std::string method::DELETE(const std::string& request, Server &server)
 		throw std::runtime_error(ERROR_400_RESPONSE); // Invalid path
 	}
 	
-	std::string filePath = locationRoot + filename;
+	server.offload(FsTask::create(FsTask::REMOVE_FILE, server, client, locationRoot + filename), client);
+	return ("");
+}
+
+std::string method::removeFile(const std::string& filePath)
+{
 	std::ifstream file(filePath.c_str());
 	if (!file.is_open())
 		throw std::runtime_error(ERROR_404_RESPONSE);
 	file.close();
 	
 	if (std::remove(filePath.c_str()) == 0)
+	{
+		uploads::unindexFile(filePath);
 		return (DELETE_200_RESPONSE);
+	}
 	else
 		throw std::runtime_error(ERROR_500_RESPONSE);
 }
@@ -486,15 +834,17 @@ std::vector<std::string> method::listFiles(const char* path)
 	return (files);
 }
 
-std::string method::generateMethodsPage(bool isRegistered)
+// The file list comes from the upload index, one page at a time
+std::string method::generateMethodsPage(bool isRegistered, const std::string& cursor)
 {
 	std::ifstream file("./www/methods.html");
 
 	if (file.is_open())
 	{
 		std::string content = gnl(file, isRegistered);
-		std::vector<std::string> allFiles = listFiles(UPLOAD_PATH);
-		std::string htmlList = generateListCheckHtml(allFiles, UPLOAD_PATH);
+		std::vector<uploads::Entry> files;
+		std::string nextCursor = uploads::indexPage(cursor, UPLOAD_PAGE_SIZE, files);
+		std::string htmlList = generateListCheckHtml(files, nextCursor);
 		size_t pos = content.find("<span>No file yet</span>");
 		if (pos != std::string::npos)
 			content.replace(pos, 24, htmlList);
@@ -510,91 +860,108 @@ std::string method::generateMethodsPage(bool isRegistered)
 		throw std::runtime_error(ERROR_404_RESPONSE);
 }
 
-std::string method::generateListCheckHtml(std::vector<std::string> allFiles, const std::string& path)
+std::string method::generateListCheckHtml(const std::vector<uploads::Entry>& files, const std::string& nextCursor)
 {
 	std::string fullList = "";
 
-	if (allFiles.empty())
+	if (files.empty())
 	{
 		fullList +=
 			"	<span class=\"no_file_method\">No files found</span>";
 		return (fullList);
 	}
 	fullList += "<ul class = \"to_delete_ul\">";
-	for (std::vector<std::string>::iterator it = allFiles.begin(); it != allFiles.end(); ++it)
+	for (std::vector<uploads::Entry>::const_iterator it = files.begin(); it != files.end(); ++it)
 	{
-		std::string		fileContent;
-		std::ifstream	currentFile((path + *it).c_str());
-		std::string		buffer;
-		if (currentFile.is_open())
-		{
-			char tempBuffer[31] = {0};
-			currentFile.read(tempBuffer, 30);
-			buffer = std::string(tempBuffer);
-			currentFile.close();
-			fullList +=
-				"<li>"
-				"	<label for=\"" + *it + "\">"
-				"		<span class=\"file_name\">" + *it + "</span>"
-				"		<p class=\"file_content\">" + buffer + "</p>"
-				"	</label>"
-				"	<input type=\"checkbox\" name=\"" + *it + "\" id=\"" + *it + "\">"
-				"</li>";
-		}
-		else
-			throw std::runtime_error(ERROR_500_RESPONSE);
+		fullList +=
+			"<li>"
+			"	<label for=\"" + it->name + "\">"
+			"		<span class=\"file_name\">" + it->name + "</span>"
+			"		<p class=\"file_content\">" + it->preview + "</p>"
+			"	</label>"
+			"	<input type=\"checkbox\" name=\"" + it->name + "\" id=\"" + it->name + "\">"
+			"</li>";
 	}
 	fullList +=
 		"</ul>"
 		"<button type=\"submit\" class=\"bigBtn\">Delete</button>";
+	if (!nextCursor.empty())
+		fullList += "<a href=\"?cursor=" + urlEncode(nextCursor) + "\" class=\"file_link\">Next files</a>";
 	return (fullList);
 }
 
 
-std::string method::generateAutoIndexPage(const LocationConfig* location, bool isRegistered)
+/*
+*	The listing comes from the per-directory cache. ?page=N and ?cursor=name
+*	select AUTOINDEX_PAGE_SIZE entries; a whole listing larger than that is
+*	streamed in chunks instead of being built as one string.
+*/
+std::string method::generateAutoIndexPage(const LocationConfig* location, bool isRegistered, const std::string& target, BodyStream*& stream)
 {
 	std::ifstream file("./www/autoindex.html");
 	
-	if (file.is_open())
-	{
-		std::string content = gnl(file, isRegistered);
-		std::vector<std::string> allFiles = listFiles(location->getLocationRoot().c_str());
-		std::string htmlList = generateListHrefHtml(allFiles);
-		size_t pos = content.find("<span class=\"file_name_autoindex\">Directory is empty</span>");
-		if (pos != std::string::npos)
-			content.replace(pos, 61, htmlList);
-		else
-			throw std::runtime_error(ERROR_500_RESPONSE);
-		return (
-			"HTTP/1.1 200 OK\r\n"
-			"Content-Type: text/html\r\n"
-			"Content-Length: " + to_string(content.length()) + "\r\n"
-			"\r\n" + content);
-	}
-	else
+	if (!file.is_open())
 		throw std::runtime_error(ERROR_404_RESPONSE);
-}
+	std::string content = gnl(file, isRegistered);
+	size_t pos = content.find("<span class=\"file_name_autoindex\">Directory is empty</span>");
+	if (pos == std::string::npos)
+		throw std::runtime_error(ERROR_500_RESPONSE);
+	DirListing* listing = DirListing::acquire(location->getLocationRoot());
+	if (!listing)
+		throw std::runtime_error(ERROR_500_RESPONSE);
 
-std::string method::generateListHrefHtml(std::vector<std::string> allFiles)
-{
-	std::string fullList = "";
+	const std::vector<std::string>& names = listing->getNames();
+	size_t begin = 0;
+	size_t end = names.size();
+	std::string navigation;
+	std::string cursor = getQueryParam(target, "cursor");
+	std::string page = getQueryParam(target, "page");
+	if (!cursor.empty())
+	{
+		begin = std::upper_bound(names.begin(), names.end(), cursor) - names.begin();
+		end = std::min(names.size(), begin + AUTOINDEX_PAGE_SIZE);
+		if (end < names.size())
+			navigation += "<a href=\"?cursor=" + urlEncode(names[end - 1]) + "\" class=\"file_link\">Next</a>";
+	}
+	else if (!page.empty())
+	{
+		size_t number = std::max(1L, atol(page.c_str()));
+		begin = std::min(names.size(), (number - 1) * AUTOINDEX_PAGE_SIZE);
+		end = std::min(names.size(), begin + AUTOINDEX_PAGE_SIZE);
+		if (number > 1)
+			navigation += "<a href=\"?page=" + to_string(number - 1) + "\" class=\"file_link\">Previous</a>";
+		if (end < names.size())
+			navigation += "<a href=\"?page=" + to_string(number + 1) + "\" class=\"file_link\">Next</a>";
+	}
 
-	if (allFiles.empty())
+	std::string head = content.substr(0, pos);
+	std::string tail = navigation + content.substr(pos + 61);
+	if (begin == end)
+		head += "	<span class=\"file_name_autoindex\">directory is empty</span>";
+	else
 	{
-		fullList +=
-			"	<span class=\"file_name_autoindex\">directory is empty</span>";
-		return (fullList);
+		head += "<span class=\"file_name_autoindex\">Files:</span><ul class=\"file_list\">";
+		tail = "</ul>" + tail;
 	}
-	fullList += "<span class=\"file_name_autoindex\">Files:</span>";
-	fullList += "<ul class=\"file_list\">";
-	for (std::vector<std::string>::iterator it = allFiles.begin(); it != allFiles.end(); ++it)
+	AutoIndexStream* body = new AutoIndexStream(listing, begin, end, head, tail);
+	if (end - begin > AUTOINDEX_PAGE_SIZE)
 	{
-		fullList +=
-			"<li><a href=\"" + *it + "\" class=\"file_link\">" + *it + "</a></li>";
+		stream = body;
+		return (
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/html\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n");
 	}
-	fullList += 
-		"</ul>";
-	return (fullList);
+	std::string html;
+	while (body->read(html))
+		;
+	delete body;
+	return (
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/html\r\n"
+		"Content-Length: " + to_string(html.length()) + "\r\n"
+		"\r\n" + html);
 }
 
 std::string method::POST_303_RESPONSE(const std::string& location, bool setCookie) {
@@ -623,7 +990,7 @@ bool method::checkPermissions(const std::string& type, const LocationConfig* loc
 		throw std::runtime_error(ERROR_500_RESPONSE);
 	if (type == "GET" && location->getLocationAutoIndex())
 		return (true);
-	std::vector<std::string> allowedMethods = location->getLocationAllowedMethods();
+	const std::vector<std::string>& allowedMethods = location->getLocationAllowedMethods();
 	if (allowedMethods.empty())
 		throw std::runtime_error(ERROR_500_RESPONSE);
 	for (std::vector<std::string>::const_iterator it = allowedMethods.begin(); it != allowedMethods.end(); ++it)
@@ -634,9 +1001,13 @@ bool method::checkPermissions(const std::string& type, const LocationConfig* loc
 	return (false);
 }
 
-std::string method::handleCGI(const std::string& request, const std::string& cgiFilePath, int port) {
-    (void)port;
-    
+/*
+*	Starts the script and suspends the client: the output is collected by
+*	the event loop (Server::handleCgiEvent) and the response is sent from
+*	Server::finishCgi. Identical GETs on a cached location join the running
+*	script instead of forking their own.
+*/
+std::string method::handleCGI(const std::string& request, const std::string& cgiFilePath, int port, Server& server, const LocationConfig* location, Client *client) {
     // Parse HTTP request
     std::istringstream requestStream(request);
     std::string requestLine;
@@ -669,14 +1040,13 @@ std::string method::handleCGI(const std::string& request, const std::string& cgi
         }
     }
     
-    // Extract request body for POST
+    // Extract request body for POST, byte for byte (CR and NUL included)
     std::string requestBody;
-    if (method == "POST") {
-        std::string bodyLine;
-        while (std::getline(requestStream, bodyLine)) {
-            if (!requestBody.empty()) requestBody += "\n";
-            requestBody += bodyLine;
-        }
+    size_t bodyStart = request.find("\r\n\r\n");
+    if (method == "POST" && bodyStart != std::string::npos) {
+        bodyStart += 4;
+        size_t bodyLength = std::min(request.size() - bodyStart, client->getExpectedContentLength());
+        requestBody = request.substr(bodyStart, bodyLength);
     }
     
     // Verify CGI script exists and is executable
@@ -685,9 +1055,31 @@ std::string method::handleCGI(const std::string& request, const std::string& cgi
         throw std::runtime_error(ERROR_404_RESPONSE);
     }
 
+    // Serve a cached output without forking when the location opted in
+    CgiCache& cache = server.getCgiCache();
+    bool cacheable = (method == "GET" && location->getLocationCgiCacheTtl() > 0);
+    std::string cacheKey;
+    if (cacheable) {
+        cacheKey = CgiCache::buildKey(cgiFilePath, queryString, port, location->getLocationCgiCacheKey(), headers);
+        std::string cachedResponse;
+        bool hit = cache.lookup(cacheKey, cachedResponse);
+        server.countCache(METRICS_CGI_CACHE, hit);
+        if (hit)
+            return cachedResponse;
+    }
+    bool coalesce = cacheable && !client->getBypassFlight();
+    if (coalesce && server.joinFlight(cacheKey, client))
+        return ("");
+
     // Create pipes
+    // close-on-exec: a script forked while another one's body is still
+    // being fed must not inherit that pipe and hold its stdin open; dup2
+    // clears the flag on the child's own fds 0 and 1
     int stdinPipe[2], stdoutPipe[2];
-    if (pipe(stdinPipe) == -1 || pipe(stdoutPipe) == -1) {
+    if (pipe2(stdinPipe, O_CLOEXEC) == -1)
+        throw std::runtime_error(ERROR_500_RESPONSE);
+    if (pipe2(stdoutPipe, O_CLOEXEC) == -1) {
+        close(stdinPipe[0]); close(stdinPipe[1]);
         throw std::runtime_error(ERROR_500_RESPONSE);
     }
 
@@ -700,6 +1092,7 @@ std::string method::handleCGI(const std::string& request, const std::string& cgi
 
     if (pid == 0) {
         // Child process: setup and execute CGI script
+        setpgid(0, 0); // own process group so a timeout also kills what the script spawned
         dup2(stdinPipe[0], STDIN_FILENO);
         dup2(stdoutPipe[1], STDOUT_FILENO);
         close(stdinPipe[0]); close(stdinPipe[1]);
@@ -738,49 +1131,28 @@ std::string method::handleCGI(const std::string& request, const std::string& cgi
         exit(1);
         
     } else {
-        // Parent process: handle I/O and collect output
+        // Parent process: hand both pipes to the event loop, the body is
+        // written to stdin as the script consumes it
         close(stdinPipe[0]);
         close(stdoutPipe[1]);
-
-        // Send POST data if present
-        if (method == "POST" && !requestBody.empty()) {
-            write(stdinPipe[1], requestBody.c_str(), requestBody.length());
-        }
-        close(stdinPipe[1]);
-
-        // Read CGI output with timeout
-        std::string output;
-        char buffer[4096];
-        fd_set readfds;
-        struct timeval timeout;
-        timeout.tv_sec = 10;
-        timeout.tv_usec = 0;
-        
-        while (true) {
-            FD_ZERO(&readfds);
-            FD_SET(stdoutPipe[0], &readfds);
-            
-            int selectResult = select(stdoutPipe[0] + 1, &readfds, NULL, NULL, &timeout);
-            if (selectResult <= 0) break;
-            
-            ssize_t bytesRead = read(stdoutPipe[0], buffer, sizeof(buffer) - 1);
-            if (bytesRead <= 0) break;
-            
-            output.append(buffer, bytesRead);
-        }
-        
-        close(stdoutPipe[0]);
-        waitpid(pid, NULL, 0);
-        
-        if (output.empty()) {
-            throw std::runtime_error(ERROR_500_RESPONSE);
+        if (requestBody.empty()) {
+            close(stdinPipe[1]);
+            stdinPipe[1] = -1;
         }
-        
-        return parseCGIResponse(output);
+
+        CgiProcess* cgi = new CgiProcess(pid, stdoutPipe[0], stdinPipe[1], requestBody, client);
+        cgi->setCaching(cacheKey, cacheable, coalesce, location->getLocationCgiCacheTtl());
+        server.startCgi(cgi, client);
+        return ("");
     }
 }
 
-std::string method::parseCGIResponse(const std::string& cgiOutput) {
+/*
+*	maxAge is set from the Cache-Control header emitted by the script:
+*	-1 when absent, 0 when the response must not be cached
+*/
+std::string method::parseCGIResponse(const std::string& cgiOutput, int& maxAge) {
+    maxAge = -1;
     // Find header/body separator
     size_t headerEndPos = cgiOutput.find("\r\n\r\n");
     if (headerEndPos == std::string::npos) {
@@ -802,6 +1174,7 @@ std::string method::parseCGIResponse(const std::string& cgiOutput) {
     // Build HTTP response
     std::string httpResponse = "HTTP/1.1 200 OK\r\n";
     bool hasContentType = false;
+    bool uncacheable = false;
     
     if (!cgiHeaders.empty()) {
         std::istringstream headerStream(cgiHeaders);
@@ -816,9 +1189,24 @@ std::string method::parseCGIResponse(const std::string& cgiOutput) {
             if (headerLine.find("Content-Type:") != std::string::npos) {
                 hasContentType = true;
             }
+            if (strncasecmp(headerLine.c_str(), "Cache-Control:", 14) == 0) {
+                std::string directives = headerLine.substr(14);
+                size_t agePos = directives.find("max-age=");
+                if (directives.find("no-store") != std::string::npos || directives.find("no-cache") != std::string::npos
+                    || directives.find("private") != std::string::npos)
+                    uncacheable = true;
+                else if (agePos != std::string::npos)
+                    maxAge = std::atoi(directives.c_str() + agePos + 8);
+            }
+            else if (strncasecmp(headerLine.c_str(), "Set-Cookie:", 11) == 0) {
+                uncacheable = true;
+            }
             httpResponse += headerLine + "\r\n";
         }
     }
+    // a later max-age must not make a private response cacheable again
+    if (uncacheable)
+        maxAge = 0;
     
     if (!hasContentType) {
         httpResponse += "Content-Type: text/html\r\n";
@@ -828,12 +1216,12 @@ std::string method::parseCGIResponse(const std::string& cgiOutput) {
     return httpResponse;
 }
 
-bool method::isCGIScript(const std::string& filePath) {
+bool method::isCGIScript(const char* filePath) {
     // Check file extension
-    if (filePath.find(".py") != std::string::npos || filePath.find(".sh") != std::string::npos)
+    if (std::strstr(filePath, ".py") || std::strstr(filePath, ".sh"))
         return true;
     
     // Check if file is executable
     struct stat statbuf;
-    return (stat(filePath.c_str(), &statbuf) == 0 && (statbuf.st_mode & S_IXUSR));
+    return (stat(filePath, &statbuf) == 0 && (statbuf.st_mode & S_IXUSR));
 }
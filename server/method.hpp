@@ -2,6 +2,9 @@
 #define METHOD_HPP
 
 #include "utils.hpp"
+#include "uploads.hpp"
+#include "DirListing.hpp"
+#include "FileBody.hpp"
 #include "Server.hpp"
 #include "../parse/LocationConfig.hpp"
 #include <iostream>
@@ -18,8 +21,17 @@
 #include <sys/select.h>
 #include <map>
 #include <cctype>
+#include <cstdlib>
+#include <strings.h>
+#include <fcntl.h>
+#include <utility>
+#include <climits>
+#include <cstdio>
 
-#define CERR_MSG(port, msg) std::cerr << "\e[31m[" + to_string(port) + "]\e[0m\t" + "\e[2m" + msg + "\e[0m" << std::endl
+#define RANGE_MAX 16 // a Range header asking for more is answered with the whole file
+#define RANGE_OFFSET_MAX 0x3fffffffffffffffLL
+#define ETAG_MAX 80 // quoted "inode-size-mtime.nsec-r" in hex
+#define VALIDATORS_MAX 256 // Content-Encoding, Vary, ETag and Last-Modified lines
 
 const std::string DELETE_200_RESPONSE =
 	"HTTP/1.1 200 OK\r\n"
@@ -63,6 +75,20 @@ const std::string ERROR_413_RESPONSE =
 	"\r\n"
 	"<html><body><h1>413 Payload Too Large</h1><p>Request is too big.</p></body></html>";
 	
+const std::string ERROR_414_RESPONSE =
+	"HTTP/1.1 414 URI Too Long\r\n"
+	"Content-Type: text/html\r\n"
+	"Content-Length: 83\r\n"
+	"\r\n"
+	"<html><body><h1>414 URI Too Long</h1><p>Request line is too long.</p></body></html>";
+
+const std::string ERROR_431_RESPONSE =
+	"HTTP/1.1 431 Request Header Fields Too Large\r\n"
+	"Content-Type: text/html\r\n"
+	"Content-Length: 107\r\n"
+	"\r\n"
+	"<html><body><h1>431 Request Header Fields Too Large</h1><p>Request headers are too large.</p></body></html>";
+
 const std::string ERROR_500_RESPONSE =
 	"HTTP/1.1 500 Internal Server Error\r\n"
 	"Content-Type: text/html\r\n"
@@ -80,31 +106,42 @@ const std::string POST_201_RESPONSE =
 class Server;
 namespace method
 {
-	std::string					GET(const std::string& request, int port, Server &server, bool);
-	std::string					POST(const std::string &request, int port, Server &server);
-	std::string					DELETE(const std::string& request, Server &server);
+	std::string					GET(const std::string& request, int port, Server &server, Client *client);
+	std::string					POST(const std::string &request, int port, Server &server, Client *client);
+	std::string					DELETE(const std::string& request, Server &server, Client *client);
 
-	std::string					foundPage(const std::string& filePath, bool isRegistered);
+	void						foundPage(const std::string& filePath, const std::string& contentType, bool isRegistered, const std::string& request, BodyStream*& stream, bool gzipStatic, std::string& response);
+	const char*					findSidecar(const std::string& filePath, struct stat& info, const char* acceptEncoding, size_t length, char* path, size_t size);
+	bool						acceptsEncoding(const char* acceptEncoding, size_t length, const char* coding);
+	void						rangedResponse(std::string& response, const std::string& request, const std::string& contentType, const char* headers,
+									const char* etag, time_t mtime, off_t length, const std::string* content, FileBody* body);
+	bool						selectRanges(const std::string& request, const char* etag, time_t mtime, off_t length,
+									std::vector<std::pair<off_t, off_t> >& ranges);
+	bool						parseOffset(const std::string& str, off_t& offset);
+	void						makeETag(const struct stat& info, bool withRegisterLink, char* etag);
+	void						makeValidators(char* validators, bool vary, const char* coding, const char* etag, time_t mtime);
+	bool						isNotModified(const std::string& request, const char* etag, time_t mtime);
 	std::string					getErrorHtml(int port, const std::string& errorMessage, Server &server, bool isRegistered);
 
 	std::vector<std::string>	listFiles(const char* path);
-	std::string					generateMethodsPage(bool isRegistered);
-	std::string					generateAutoIndexPage(const LocationConfig* location, bool isRegistered);
-	std::string					generateListHrefHtml(std::vector<std::string> allFiles);
-	std::string					generateListCheckHtml(std::vector<std::string> allFiles, const std::string& path);
-	std::string					checkDeleteRequest(const std::string &request, Server &server);
+	std::string					generateMethodsPage(bool isRegistered, const std::string& cursor = "");
+	std::string					generateAutoIndexPage(const LocationConfig* location, bool isRegistered, const std::string& target, BodyStream*& stream);
+	std::string					generateListCheckHtml(const std::vector<uploads::Entry>& files, const std::string& nextCursor);
+	std::string					checkDeleteRequest(const std::string &request, Server &server, Client *client);
 	std::string					handleDeleteRequest(const std::string& request);
 	std::string					deleteTargetFiles(std::vector<std::string>);
 	std::string					trimFileName(std::string);
-	std::string					postFromDashboard(const std::string &request, Server &server);
-	std::string					postFromTerminal(const std::string &request, Server &server);
+	std::string					removeFile(const std::string& filePath);
+	std::string					postFromDashboard(const std::string &request, ssize_t bodyLimit);
+	std::string					postFromTerminal(const std::string &request, ssize_t bodyLimit);
 	bool						checkPermissions(const std::string& type, const LocationConfig* location);
 	
 	// CGI
-	std::string					handleCGI(const std::string& request, const std::string& cgiFilePath, int port);
-	std::string					parseCGIResponse(const std::string& cgiOutput);
-	bool						isCGIScript(const std::string& filePath);
-	std::string					handleFileUpload(const std::string& request, Server& server);
+	std::string					handleCGI(const std::string& request, const std::string& cgiFilePath, int port, Server& server, const LocationConfig* location, Client *client);
+	std::string					parseCGIResponse(const std::string& cgiOutput, int& maxAge);
+	bool						isCGIScript(const char* filePath);
+	std::string					handleFileUpload(const std::string& request, Server& server, Client *client);
+	std::string					finishUpload(MultipartParser& parser, const std::string& body);
 
 	// helper status code
 	std::string					POST_303_RESPONSE(const std::string& location, bool setCookie = false);
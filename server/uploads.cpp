@@ -0,0 +1,264 @@
+#include "uploads.hpp"
+#include "utils.hpp"
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <map>
+
+namespace uploads
+{
+	static std::map<std::string, Entry>	g_index;
+	static pthread_mutex_t				g_indexLock = PTHREAD_MUTEX_INITIALIZER;
+	static unsigned long				g_indexGeneration = 0; // bumped on every change
+
+	static unsigned int	hashName(const std::string& name)
+	{
+		unsigned int hash = 2166136261u;
+		for (size_t i = 0; i < name.size(); i++)
+		{
+			hash ^= (unsigned char)name[i];
+			hash *= 16777619u;
+		}
+		return (hash);
+	}
+
+	static std::string	hexByte(unsigned int value)
+	{
+		const char* digits = "0123456789abcdef";
+		std::string hex(2, '0');
+		hex[0] = digits[(value >> 4) & 0xf];
+		hex[1] = digits[value & 0xf];
+		return (hex);
+	}
+
+	std::string	shardDir(const std::string& name, const std::string& root)
+	{
+		unsigned int hash = hashName(name);
+		return (root + UPLOAD_STORE + hexByte(hash >> 24) + "/" + hexByte(hash >> 16) + "/");
+	}
+
+	bool	makeShardDir(const std::string& name, const std::string& root)
+	{
+		std::string dir = shardDir(name, root);
+		std::string levels[3] = { root + UPLOAD_STORE, dir.substr(0, dir.size() - 3), dir };
+		for (int i = 0; i < 3; i++)
+		{
+			if (mkdir(levels[i].c_str(), 0755) == -1 && errno != EEXIST)
+				return (false);
+		}
+		return (true);
+	}
+
+	// Sharded location first, then the flat legacy one
+	std::string	pathOf(const std::string& name, const std::string& root)
+	{
+		if (name.find('/') != std::string::npos)
+			return (root + name);
+		std::string path = shardDir(name, root) + name;
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+			return (path);
+		return (root + name);
+	}
+
+	// A path straight under the upload directory may live in a shard;
+	// resolved in place, any other path is left as is
+	void	locate(std::string& path)
+	{
+		const size_t rootLength = sizeof(UPLOAD_PATH) - 1;
+		if (path.compare(0, rootLength, UPLOAD_PATH) != 0 || path.find('/', rootLength) != std::string::npos)
+			return ;
+		path = pathOf(path.substr(rootLength));
+	}
+
+	int	create(const std::string& name, std::string& path)
+	{
+		if (!makeShardDir(name))
+			return (-1);
+		path = shardDir(name) + name;
+		return (open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644));
+	}
+
+	/*
+	*	Creates a new file named <prefix><time>-<pid>-<counter><extension>.
+	*	The pid tells workers apart and the counter tells apart uploads of
+	*	the same second, so the name is new and O_EXCL makes the claim
+	*	atomic: one open per upload. EEXIST only happens if a file was left
+	*	by an earlier process that had the same pid, and the counter moves
+	*	past it. Uploads are written by I/O workers, so the counter is
+	*	taken with an atomic increment: two workers must never get the
+	*	same id.
+	*/
+	int	createUnique(const std::string& prefix, const std::string& extension, std::string& path)
+	{
+		static unsigned long		counter = 0;
+		static const std::string	worker = to_string(getpid());
+
+		while (true)
+		{
+			unsigned long id = __sync_fetch_and_add(&counter, 1);
+			std::string name = prefix + to_string(time(0)) + "-" + worker + "-" + to_string(id) + extension;
+			int fd = create(name, path);
+			if (fd != -1 || errno != EEXIST)
+				return (fd);
+		}
+	}
+
+	static bool	listDir(const std::string& dir, unsigned char type, std::vector<std::string>& names)
+	{
+		DIR* handle = opendir(dir.c_str());
+		if (handle == NULL)
+			return (false);
+		struct dirent* entry;
+		while ((entry = readdir(handle)))
+		{
+			std::string name = entry->d_name;
+			if (entry->d_type == type && name != "." && name != "..")
+				names.push_back(name);
+		}
+		closedir(handle);
+		return (true);
+	}
+
+	// Flat legacy files plus every shard; fails only if root is unreadable
+	bool	list(std::vector<std::string>& names, const std::string& root)
+	{
+		if (!listDir(root, DT_REG, names))
+			return (false);
+		std::string store = root + UPLOAD_STORE;
+		std::vector<std::string> first;
+		listDir(store, DT_DIR, first);
+		for (size_t i = 0; i < first.size(); i++)
+		{
+			std::vector<std::string> second;
+			listDir(store + first[i], DT_DIR, second);
+			for (size_t j = 0; j < second.size(); j++)
+				listDir(store + first[i] + "/" + second[j], DT_REG, names);
+		}
+		return (true);
+	}
+
+	/*
+	┌───────────────────────────────────┐
+	│               INDEX               │
+	└───────────────────────────────────┘
+	*/
+
+	// Name of an upload from its path, empty if it is not an upload
+	static std::string	uploadName(const std::string& path)
+	{
+		std::string root = UPLOAD_PATH;
+		if (path.compare(0, root.size(), root) != 0)
+			return ("");
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		if (path != root + name && path != shardDir(name) + name)
+			return ("");
+		return (name);
+	}
+
+	static bool	readEntry(const std::string& name, const std::string& path, Entry& entry)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) == -1 || !S_ISREG(info.st_mode))
+			return (false);
+		entry.name = name;
+		entry.path = path;
+		entry.size = info.st_size;
+		entry.mtime = info.st_mtime;
+		char buffer[UPLOAD_PREVIEW];
+		ssize_t bytes = 0;
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd != -1)
+		{
+			bytes = read(fd, buffer, sizeof(buffer));
+			close(fd);
+		}
+		// like before, the preview stops at the first NUL
+		entry.preview = std::string(buffer, bytes > 0 ? bytes : 0);
+		entry.preview = entry.preview.substr(0, entry.preview.find('\0'));
+		return (true);
+	}
+
+	// One full scan at startup; afterwards only the handlers touch the index
+	bool	loadIndex()
+	{
+		std::vector<std::string> names;
+		if (!list(names))
+			return (false);
+		std::map<std::string, Entry> index;
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			Entry entry;
+			if (readEntry(names[i], pathOf(names[i]), entry))
+				index[names[i]] = entry;
+		}
+		pthread_mutex_lock(&g_indexLock);
+		g_index.swap(index);
+		g_indexGeneration++;
+		pthread_mutex_unlock(&g_indexLock);
+		return (true);
+	}
+
+	void	indexFile(const std::string& path)
+	{
+		std::string name = uploadName(path);
+		Entry entry;
+		if (name.empty() || !readEntry(name, path, entry))
+			return ;
+		pthread_mutex_lock(&g_indexLock);
+		g_index[name] = entry;
+		g_indexGeneration++;
+		pthread_mutex_unlock(&g_indexLock);
+	}
+
+	void	unindexFile(const std::string& path)
+	{
+		std::string name = uploadName(path);
+		if (name.empty())
+			return ;
+		pthread_mutex_lock(&g_indexLock);
+		g_index.erase(name);
+		g_indexGeneration++;
+		pthread_mutex_unlock(&g_indexLock);
+	}
+
+	/*
+	*	Copies up to limit entries named after cursor (from the start when
+	*	cursor is empty) and returns the cursor of the next page, empty on
+	*	the last one.
+	*/
+	std::string	indexPage(const std::string& cursor, size_t limit, std::vector<Entry>& entries)
+	{
+		std::string next;
+		pthread_mutex_lock(&g_indexLock);
+		std::map<std::string, Entry>::const_iterator it = cursor.empty() ? g_index.begin() : g_index.upper_bound(cursor);
+		for (; it != g_index.end() && entries.size() < limit; ++it)
+			entries.push_back(it->second);
+		if (it != g_index.end() && !entries.empty())
+			next = entries.back().name;
+		pthread_mutex_unlock(&g_indexLock);
+		return (next);
+	}
+
+	// Every name, sorted, for the autoindex of the upload directory
+	void	indexNames(std::vector<std::string>& names)
+	{
+		pthread_mutex_lock(&g_indexLock);
+		names.reserve(g_index.size());
+		for (std::map<std::string, Entry>::const_iterator it = g_index.begin(); it != g_index.end(); ++it)
+			names.push_back(it->first);
+		pthread_mutex_unlock(&g_indexLock);
+	}
+
+	unsigned long	indexGeneration()
+	{
+		pthread_mutex_lock(&g_indexLock);
+		unsigned long generation = g_indexGeneration;
+		pthread_mutex_unlock(&g_indexLock);
+		return (generation);
+	}
+}
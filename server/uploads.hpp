@@ -0,0 +1,54 @@
+#ifndef UPLOADS_HPP
+#define UPLOADS_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/types.h>
+
+#define UPLOAD_PATH "./www/uploads/"
+#define UPLOAD_STORE ".store/" // shard tree inside the upload directory
+#define UPLOAD_PREVIEW 30 // bytes of content shown on the methods page
+#define UPLOAD_PAGE_SIZE 50 // files per methods page
+
+/*
+*	Uploaded files are stored as <root>.store/<h1>/<h2>/<name>, where h1
+*	and h2 are the first two bytes (hex) of the FNV-1a hash of the name, so
+*	no directory grows past a few dozen entries and a name is found without
+*	listing anything. Files still lying flat in <root> (from before the
+*	shards, see tools/migrate_uploads.cpp) keep being served and deleted.
+*
+*	The methods page is rendered from an in-memory index of the stored
+*	files, sorted by name, built once at startup and kept up to date by the
+*	upload and delete handlers. It is shared with the I/O pool threads, so
+*	every access goes through a mutex.
+*/
+namespace uploads
+{
+	struct Entry
+	{
+		std::string	name;
+		std::string	path;
+		off_t		size;
+		time_t		mtime;
+		std::string	preview;
+	};
+
+	std::string		shardDir(const std::string& name, const std::string& root = UPLOAD_PATH);
+	bool			makeShardDir(const std::string& name, const std::string& root = UPLOAD_PATH);
+	std::string		pathOf(const std::string& name, const std::string& root = UPLOAD_PATH);
+	void			locate(std::string& path);
+	int				create(const std::string& name, std::string& path);
+	int				createUnique(const std::string& prefix, const std::string& extension, std::string& path);
+	bool			list(std::vector<std::string>& names, const std::string& root = UPLOAD_PATH);
+
+	// index
+	bool			loadIndex();
+	void			indexFile(const std::string& path);
+	void			unindexFile(const std::string& path);
+	std::string		indexPage(const std::string& cursor, size_t limit, std::vector<Entry>& entries);
+	void			indexNames(std::vector<std::string>& names);
+	unsigned long	indexGeneration();
+}
+
+#endif
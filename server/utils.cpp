@@ -1,5 +1,10 @@
 #include "utils.hpp"
 #include <iostream>
+#include <unistd.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
 
 std::string gnl(std::ifstream& file, bool isRegistered)
 {
@@ -18,8 +23,180 @@ std::string gnl(std::ifstream& file, bool isRegistered)
 	return (content);
 }
 
+bool	writeAll(int fd, const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t written = write(fd, data, length);
+		if (written <= 0)
+			return (false);
+		data += written;
+		length -= written;
+	}
+	return (true);
+}
+
+std::string	urlEncode(const std::string& value)
+{
+	const char* digits = "0123456789ABCDEF";
+	std::string encoded;
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		unsigned char c = value[i];
+		if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+			encoded += c;
+		else
+		{
+			encoded += '%';
+			encoded += digits[c >> 4];
+			encoded += digits[c & 0xf];
+		}
+	}
+	return (encoded);
+}
+
+std::string	urlDecode(const std::string& value)
+{
+	std::string decoded;
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		if (value[i] == '+')
+			decoded += ' ';
+		else if (value[i] == '%' && i + 2 < value.size() && isxdigit(value[i + 1]) && isxdigit(value[i + 2]))
+		{
+			decoded += (char)strtol(value.substr(i + 1, 2).c_str(), NULL, 16);
+			i += 2;
+		}
+		else
+			decoded += value[i];
+	}
+	return (decoded);
+}
+
+// Decoded value of key in the query string of a request target
+std::string	getQueryParam(const std::string& target, const std::string& key)
+{
+	size_t start = target.find('?');
+	while (start != std::string::npos)
+	{
+		start++;
+		size_t end = target.find('&', start);
+		std::string pair = target.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		if (pair.compare(0, key.size() + 1, key + "=") == 0)
+			return (urlDecode(pair.substr(key.size() + 1)));
+		start = end;
+	}
+	return ("");
+}
+
+// Value of a request header (name matched case-insensitively) as a slice
+// of the request, NULL if absent
+const char*	findHeaderValue(const std::string& request, const char* name, size_t& length)
+{
+	size_t nameLength = std::strlen(name);
+	size_t headerEnd = request.find("\r\n\r\n");
+	size_t lineStart = request.find("\r\n");
+	while (lineStart != std::string::npos && lineStart < headerEnd)
+	{
+		lineStart += 2;
+		size_t lineEnd = request.find("\r\n", lineStart);
+		if (lineEnd - lineStart > nameLength && request[lineStart + nameLength] == ':')
+		{
+			size_t i = 0;
+			while (i < nameLength && tolower(request[lineStart + i]) == tolower(name[i]))
+				i++;
+			if (i == nameLength)
+			{
+				length = 0;
+				size_t valueStart = request.find_first_not_of(" \t", lineStart + i + 1);
+				if (valueStart == std::string::npos || valueStart > lineEnd)
+					return (request.data() + lineStart);
+				size_t valueEnd = request.find_last_not_of(" \t", lineEnd - 1);
+				length = valueEnd + 1 - valueStart;
+				return (request.data() + valueStart);
+			}
+		}
+		lineStart = lineEnd;
+	}
+	return (NULL);
+}
+
+// Same, as a copy; "" if absent
+std::string	getHeaderValue(const std::string& request, const std::string& name)
+{
+	size_t length;
+	const char* value = findHeaderValue(request, name.c_str(), length);
+	return (value ? std::string(value, length) : std::string());
+}
+
+// For durations: unaffected by changes of the wall clock
+unsigned long long	monotonicMicros()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+
+// IMF-fixdate, as used by Last-Modified and If-Modified-Since
+std::string	httpDate(time_t time)
+{
+	char buffer[64];
+	httpDate(time, buffer, sizeof(buffer));
+	return (buffer);
+}
+
+// Same, into the caller's buffer
+void	httpDate(time_t time, char* buffer, size_t size)
+{
+	struct tm date;
+	gmtime_r(&time, &date);
+	strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", &date);
+}
+
+// to_string without a stream: nothing is allocated once out has room
+void	appendNumber(std::string& out, long long value)
+{
+	char number[24];
+	out.append(number, std::snprintf(number, sizeof(number), "%lld", value));
+}
+
+bool	parseHttpDate(const std::string& date, time_t& time)
+{
+	struct tm parsed;
+	memset(&parsed, 0, sizeof(parsed));
+	const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &parsed);
+	if (end == NULL || *end != '\0')
+		return (false);
+	time = timegm(&parsed);
+	return (time != -1);
+}
+
 namespace logs
 {
+	volatile int threshold = Info;
+
+	static const char* const levelNames[] = {"debug", "info", "warn", "error"};
+
+	bool parseLevel(const std::string& name, Level& level)
+	{
+		for (int i = Debug; i <= Error; i++)
+		{
+			if (name == levelNames[i])
+			{
+				level = static_cast<Level>(i);
+				return (true);
+			}
+		}
+		return (false);
+	}
+
+	const char* levelName(int level)
+	{
+		if (level < Debug || level > Error)
+			return ("unknown");
+		return (levelNames[level]);
+	}
+
 	static inline void setColor(int code) { std::cout << "\033[" << code << 'm'; }
 	static inline void reset() { std::cout << "\033[0m"; }
 
@@ -4,9 +4,22 @@
 #include <sstream>
 #include <string>
 #include <fstream>
+#include <ctime>
+#include <iostream>
 
 #define NOPORT -1
 
+// Levels below LOG_MIN_LEVEL are compiled out (-DLOG_MIN_LEVEL=2 keeps warn
+// and error); the others are checked against log_level before any message
+// is built, so a filtered call never formats its arguments
+#ifndef LOG_MIN_LEVEL
+# define LOG_MIN_LEVEL 0
+#endif
+#define LOG_ENABLED(level) ((level) >= LOG_MIN_LEVEL && (level) >= logs::threshold)
+#define LOG_MSG(level, port, color, message) do { if (LOG_ENABLED(level)) logs::msg(port, color, message, true); } while (0)
+#define LOG_ERR(level, port, msg) do { if (LOG_ENABLED(level)) std::cerr << "\e[31m[" + to_string(port) + "]\e[0m\t" + "\e[2m" + msg + "\e[0m" << std::endl; } while (0)
+#define CERR_MSG(port, msg) LOG_ERR(logs::Warn, port, msg)
+
 template <typename T>
 std::string	to_string(const T& value)
 {
@@ -18,8 +31,31 @@ std::string	to_string(const T& value)
 // Tiny gnl
 std::string	gnl(std::ifstream& file, bool isRegistered);
 
+bool		writeAll(int fd, const char* data, size_t length);
+std::string	urlEncode(const std::string& value);
+std::string	urlDecode(const std::string& value);
+std::string	getQueryParam(const std::string& target, const std::string& key);
+const char*	findHeaderValue(const std::string& request, const char* name, size_t& length);
+std::string	getHeaderValue(const std::string& request, const std::string& name);
+std::string	httpDate(time_t time);
+void		httpDate(time_t time, char* buffer, size_t size);
+void		appendNumber(std::string& out, long long value);
+bool		parseHttpDate(const std::string& date, time_t& time);
+unsigned long long	monotonicMicros();
+
 namespace logs
 {
+	enum Level {
+		Debug = 0,
+		Info,
+		Warn,
+		Error
+	};
+	// Set from log_level at startup and on SIGHUP, read by every thread
+	extern volatile int threshold;
+	bool parseLevel(const std::string& name, Level& level);
+	const char* levelName(int level);
+
 	enum Color {
 		Default = 39,
 		Black = 30,
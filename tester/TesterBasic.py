@@ -5,12 +5,15 @@ Tests error codes, permissions, file uploads, configuration errors, etc.
 """
 
 import subprocess
+import socket
 import time
 import os
 import sys
 import tempfile
 import random
 import string
+import gzip
+import re
 from pathlib import Path
 
 # Colors for output
@@ -93,6 +96,244 @@ class WebservGeneralTester:
         
         print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} error code tests{RESET}")
         return passed == len(tests)
+
+    def test_keep_alive_errors(self):
+        """Test 1e: a 4xx answer to a complete request leaves the connection open"""
+        self.print_test_header("Keep-Alive After Errors")
+        
+        def read_response(sock):
+            data = b""
+            while b"\r\n\r\n" not in data:
+                chunk = sock.recv(65536)
+                if not chunk:
+                    return (None, {})
+                data += chunk
+            head, _, body = data.partition(b"\r\n\r\n")
+            lines = head.decode(errors='replace').split("\r\n")
+            headers = {}
+            for line in lines[1:]:
+                name, _, value = line.partition(":")
+                headers[name.strip().lower()] = value.strip()
+            length = int(headers.get("content-length", "0"))
+            while len(body) < length:
+                chunk = sock.recv(65536)
+                if not chunk:
+                    break
+                body += chunk
+            return (lines[0], headers)
+        
+        # each error is followed by a good request on the same connection
+        tests = [
+            ("GET /nonexistent HTTP/1.1", 404),
+            ("PUT / HTTP/1.1", 405),
+            ("DELETE /index.html HTTP/1.1", 403),
+        ]
+        
+        passed = 0
+        for request_line, expected in tests:
+            try:
+                with socket.create_connection(("127.0.0.1", 8888), timeout=5) as sock:
+                    sock.sendall(f"{request_line}\r\nHost: localhost\r\n\r\n".encode())
+                    status, headers = read_response(sock)
+                    kept = status is not None and headers.get("connection", "").lower() != "close"
+                    sock.sendall(b"GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n")
+                    follow, _ = read_response(sock)
+                if (status or "").split(" ")[1:2] == [str(expected)] and kept and (follow or "").split(" ")[1:2] == ["200"]:
+                    print(f"{GREEN}✓ {request_line} returned {expected} and the connection served the next request{RESET}")
+                    passed += 1
+                else:
+                    print(f"{RED}✗ {request_line} returned {status!r} (Connection: {headers.get('connection')!r}), "
+                          f"next request got {follow!r}{RESET}")
+            except (OSError, ValueError) as e:
+                print(f"{RED}✗ {request_line}: {e}{RESET}")
+        
+        print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} keep-alive tests{RESET}")
+        return passed == len(tests)
+    
+    def fetch(self, options, url):
+        """Run curl and return (status line, headers dict, body bytes)"""
+        result = subprocess.run(f"curl -s -D - {options} {url}", shell=True, capture_output=True, timeout=5)
+        head, _, body = result.stdout.partition(b"\r\n\r\n")
+        lines = head.decode(errors='replace').split("\r\n")
+        headers = {}
+        for line in lines[1:]:
+            name, _, value = line.partition(":")
+            headers[name.strip().lower()] = value.strip()
+        return (lines[0], headers, body)
+
+    def test_binary_files(self):
+        """Test 1a: a non-text file is served byte for byte with its media type"""
+        self.print_test_header("Binary Files")
+        
+        files = [
+            ("http://127.0.0.1:8888/favicon.ico", "www/assets/favicon.ico", "image/x-icon"),
+        ]
+        
+        passed = 0
+        for url, path, media_type in files:
+            with open(path, 'rb') as f:
+                content = f.read()
+            status, h, body = self.fetch("", url)
+            if (status.split(" ")[1:2] == ["200"] and h.get("content-type") == media_type
+                    and h.get("content-length") == str(len(content)) and body == content):
+                print(f"{GREEN}✓ {url} sent {len(content)} bytes as {media_type}, identical to {path}{RESET}")
+                passed += 1
+            else:
+                print(f"{RED}✗ {url} returned {status!r} as {h.get('content-type')!r}, "
+                      f"{len(body)} bytes {'identical' if body == content else 'different'} from {path}{RESET}")
+        
+        print(f"\n{GREEN if passed == len(files) else YELLOW}Passed {passed}/{len(files)} binary file tests{RESET}")
+        return passed == len(files)
+    
+    def test_ranges(self):
+        """Test 1b: byte ranges on a static file"""
+        self.print_test_header("Range Requests")
+
+        url = "http://127.0.0.1:8888/index.html"
+        _, headers, full = self.fetch("", url)
+        size = len(full)
+
+        def single(first, last):
+            return lambda status, h, body: (
+                h.get("content-range") == f"bytes {first}-{last}/{size}" and body == full[first:last + 1])
+
+        def multipart(status, h, body):
+            kind = h.get("content-type", "")
+            if not kind.startswith("multipart/byteranges; boundary="):
+                return False
+            boundary = kind.split("boundary=", 1)[1].encode()
+            return (body.count(b"--" + boundary) == 3
+                    and f"Content-Range: bytes 0-4/{size}".encode() in body
+                    and f"Content-Range: bytes 10-14/{size}".encode() in body
+                    and full[0:5] in body and full[10:15] in body)
+
+        tests = [
+            ("-r 0-9", 206, single(0, 9)),
+            ("-r 10-", 206, single(10, size - 1)),
+            ("-r -20", 206, single(size - 20, size - 1)),
+            ("-r 0-4,10-14", 206, multipart),
+            ("-r 0-0,1-1,2-2", 206, lambda status, h, body: body.count(b"Content-Range:") == 3),
+            # unsatisfiable: the reply says how big the file really is
+            (f"-r {size}-{size + 100}", 416, lambda status, h, body: h.get("content-range") == f"bytes */{size}"),
+            # a stale validator in If-Range turns the request into a plain GET
+            ("-r 0-9 -H 'If-Range: \"stale\"'", 200, lambda status, h, body: body == full),
+            (f"-r 0-9 -H 'If-Range: {headers.get('etag', '')}'", 206, single(0, 9)),
+        ]
+
+        passed = 0
+        for options, expected, check in tests:
+            status, h, body = self.fetch(options, url)
+            if status.split(" ")[1:2] == [str(expected)] and check(status, h, body):
+                print(f"{GREEN}✓ curl {options} returned {expected} with the expected bytes{RESET}")
+                passed += 1
+            else:
+                print(f"{RED}✗ curl {options} returned {status!r}, expected {expected} with the requested bytes{RESET}")
+
+        print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} range tests{RESET}")
+        return passed == len(tests)
+
+    def test_conditional_requests(self):
+        """Test 1c: validators answered with 304 Not Modified"""
+        self.print_test_header("Conditional Requests")
+
+        url = "http://127.0.0.1:8888/index.html"
+        _, headers, _ = self.fetch("", url)
+        etag = headers.get("etag", "")
+        modified = headers.get("last-modified", "")
+
+        tests = [
+            (f"curl -H 'If-None-Match: {etag}' {url}", 304),
+            (f"curl -H 'If-None-Match: \"other\", {etag}' {url}", 304),
+            (f"curl -H 'If-None-Match: *' {url}", 304),
+            (f"curl -H 'If-None-Match: \"other\"' {url}", 200),
+            (f"curl -H 'If-Modified-Since: {modified}' {url}", 304),
+            (f"curl -H 'If-Modified-Since: Thu, 01 Jan 1970 00:00:00 GMT' {url}", 200),
+            # If-None-Match wins over If-Modified-Since when both are sent
+            (f"curl -H 'If-None-Match: \"other\"' -H 'If-Modified-Since: {modified}' {url}", 200),
+        ]
+
+        passed = 0
+        if not etag or not modified:
+            print(f"{RED}✗ {url} sent no ETag or Last-Modified{RESET}")
+        else:
+            for cmd, expected in tests:
+                if self.run_curl(cmd, expected):
+                    passed += 1
+
+        print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} conditional request tests{RESET}")
+        return passed == len(tests)
+
+    def test_gzip_static(self):
+        """Test 1d: gzip_static sends a precompressed sidecar to clients that accept it"""
+        self.print_test_header("gzip_static Sidecars")
+        
+        url = "http://127.0.0.1:8888/style/style.css"  # gzip_static on in example.conf
+        source = "www/style/style.css"
+        sidecar = source + ".gz"
+        with open(source, 'rb') as f:
+            original = f.read()
+        with open(sidecar, 'wb') as f:
+            f.write(gzip.compress(original))
+        
+        def encoded(status, h, body):
+            return h.get("content-encoding") == "gzip" and gzip.decompress(body) == original
+        
+        def identity(status, h, body):
+            return "content-encoding" not in h and body == original
+        
+        tests = [
+            ("-H 'Accept-Encoding: gzip'", encoded),
+            ("-H 'Accept-Encoding: br;q=0.5, gzip'", encoded),
+            ("", identity),
+            ("-H 'Accept-Encoding: gzip;q=0'", identity),
+        ]
+        
+        passed = 0
+        try:
+            for options, check in tests:
+                status, h, body = self.fetch(options, url)
+                # both variants say the response depends on Accept-Encoding
+                vary = h.get("vary", "").lower() == "accept-encoding"
+                if status.split(" ")[1:2] == ["200"] and vary and check(status, h, body):
+                    print(f"{GREEN}✓ curl {options or '(no Accept-Encoding)'} got the {check.__name__} body with Vary{RESET}")
+                    passed += 1
+                else:
+                    print(f"{RED}✗ curl {options or '(no Accept-Encoding)'} returned {status!r}, "
+                          f"Content-Encoding {h.get('content-encoding')!r}, Vary {h.get('vary')!r}{RESET}")
+        finally:
+            os.unlink(sidecar)
+        
+        print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} gzip_static tests{RESET}")
+        return passed == len(tests)
+    
+    def test_gzip_responses(self):
+        """Test 1f: generated pages are compressed on the fly for clients that accept gzip"""
+        self.print_test_header("On-the-fly gzip")
+        
+        urls = [
+            "http://127.0.0.1:8888/methods",   # methods page
+            "http://127.0.0.1:8888/uploads/",  # autoindex listing, streamed
+        ]
+        
+        passed = 0
+        for url in urls:
+            _, plain_headers, plain = self.fetch("", url)
+            status, h, body = self.fetch("-H 'Accept-Encoding: gzip'", url)
+            try:
+                same = gzip.decompress(body) == plain
+            except (OSError, EOFError):
+                same = False
+            if (status.split(" ")[1:2] == ["200"] and h.get("content-encoding") == "gzip"
+                    and h.get("vary", "").lower() == "accept-encoding" and same
+                    and "content-encoding" not in plain_headers):
+                print(f"{GREEN}✓ {url} was gzipped for a client that accepts it, plain for one that does not{RESET}")
+                passed += 1
+            else:
+                print(f"{RED}✗ {url} returned {status!r}, Content-Encoding {h.get('content-encoding')!r}, "
+                      f"{'same' if same else 'different'} content once decompressed{RESET}")
+        
+        print(f"\n{GREEN if passed == len(urls) else YELLOW}Passed {passed}/{len(urls)} gzip tests{RESET}")
+        return passed == len(urls)
     
     def test_file_uploads(self):
         """Test 2: POST files of different sizes"""
@@ -122,6 +363,61 @@ class WebservGeneralTester:
         print(f"\n{GREEN if passed == len(test_files) else YELLOW}Passed {passed}/{len(test_files)} file upload tests{RESET}")
         return passed == len(test_files)
     
+    def test_multipart_uploads(self):
+        """Test 2b: a multipart upload stores every file part under its own name"""
+        self.print_test_header("File Uploads - Multipart")
+        
+        tag = ''.join(random.choices(string.ascii_lowercase, k=8))
+        parts = {
+            f"first_{tag}.txt": b"first file\n",
+            f"second_{tag}.bin": bytes(range(256)) * 150,  # spans several receive chunks
+        }
+        paths = []
+        for name, content in parts.items():
+            path = os.path.join(tempfile.gettempdir(), name)
+            with open(path, 'wb') as f:
+                f.write(content)
+            paths.append(path)
+        
+        passed = 0
+        total = 2 + len(parts)
+        # sent once: run_curl would send the upload twice
+        forms = " ".join(f"-F 'file{i}=@{path}'" for i, path in enumerate(paths))
+        status, _, _ = self.fetch(f"{forms} -F 'comment=not a file'", "http://127.0.0.1:8888/methods")
+        if status.split(" ")[1:2] == ["201"]:
+            print(f"{GREEN}✓ multipart POST of {len(parts)} files returned 201{RESET}")
+            passed += 1
+        else:
+            print(f"{RED}✗ multipart POST of {len(parts)} files returned {status!r}, expected 201{RESET}")
+        
+        # files are sharded under the upload store, look them up by name
+        stored = {}
+        for root, _, files in os.walk("www/uploads"):
+            for name in files:
+                if name in parts:
+                    with open(os.path.join(root, name), 'rb') as f:
+                        stored[name] = f.read()
+        for name, content in parts.items():
+            if stored.get(name) == content:
+                print(f"{GREEN}✓ {name} was stored under its own name, byte for byte{RESET}")
+                passed += 1
+            else:
+                print(f"{RED}✗ {name} was not stored under its own name with its content{RESET}")
+        
+        _, _, page = self.fetch("", "http://127.0.0.1:8888/methods")
+        if all(name.encode() in page for name in parts):
+            print(f"{GREEN}✓ the methods page lists the uploaded files{RESET}")
+            passed += 1
+        else:
+            print(f"{RED}✗ the methods page does not list the uploaded files{RESET}")
+        
+        for name, path in zip(parts, paths):
+            subprocess.run(f"curl -s -o /dev/null -X DELETE http://127.0.0.1:8888/uploads/{name}", shell=True, timeout=5)
+            os.unlink(path)
+        
+        print(f"\n{GREEN if passed == total else YELLOW}Passed {passed}/{total} multipart upload tests{RESET}")
+        return passed == total
+    
     def test_permission_errors(self):
         """Test 3: POST to URLs without permissions"""
         self.print_test_header("Permission Tests")
@@ -380,6 +676,205 @@ server {
         print(f"\n{GREEN if passed == len(tests) else YELLOW}Passed {passed}/{len(tests)} CGI tests{RESET}")
         return passed == len(tests)
     
+    def test_cgi_cache_private(self):
+        """Test 7b: a CGI response with Set-Cookie is never served from cgi_cache"""
+        self.print_test_header("CGI Cache - Private Responses")
+        
+        script_dir = tempfile.mkdtemp()
+        scripts = {
+            # max-age after Set-Cookie used to make the response cacheable again
+            "cookie.sh": "Set-Cookie: session=%s\\r\\nCache-Control: max-age=60",
+            # header names are case-insensitive
+            "lower.sh": "set-cookie: session=%s\\r\\ncache-control: max-age=60",
+        }
+        for name, headers in scripts.items():
+            path = os.path.join(script_dir, name)
+            with open(path, 'w') as f:
+                f.write("#!/bin/sh\nprintf 'Content-Type: text/plain\\r\\n" + headers + "\\r\\n\\r\\nhello\\n' \"$$\"\n")
+            os.chmod(path, 0o755)
+        
+        config = f"""
+server {{
+    host 127.0.0.1;
+    listen 9997;
+    server_name cache_server;
+    root {script_dir}/;
+    
+    location /cookie {{
+        root {script_dir}/;
+        index cookie.sh;
+        allowed_methods GET;
+        cgi_cache 30;
+    }}
+    location /lower {{
+        root {script_dir}/;
+        index lower.sh;
+        allowed_methods GET;
+        cgi_cache 30;
+    }}
+}}
+"""
+        fd, config_path = tempfile.mkstemp(suffix='.conf')
+        with os.fdopen(fd, 'w') as f:
+            f.write(config)
+        
+        passed = 0
+        server = None
+        try:
+            server = subprocess.Popen([self.binary_path, config_path],
+                                      stdout=subprocess.PIPE,
+                                      stderr=subprocess.PIPE)
+            time.sleep(2)
+            for target in ("/cookie", "/lower"):
+                cookies = []
+                for _ in range(2):
+                    result = subprocess.run(
+                        f"curl -s -D - -o /dev/null http://127.0.0.1:9997{target}",
+                        shell=True, capture_output=True, text=True, timeout=5)
+                    cookies += [line.strip() for line in result.stdout.splitlines()
+                                if line.lower().startswith("set-cookie:")]
+                if len(cookies) == 2 and cookies[0] != cookies[1]:
+                    print(f"{GREEN}✓ {target}: each client got its own cookie ({cookies[0]} / {cookies[1]}){RESET}")
+                    passed += 1
+                else:
+                    print(f"{RED}✗ {target}: Set-Cookie response was shared from the cache: {cookies}{RESET}")
+        except Exception as e:
+            print(f"{RED}✗ Error testing CGI cache: {e}{RESET}")
+        finally:
+            if server:
+                server.terminate()
+                server.wait(timeout=5)
+            os.unlink(config_path)
+            for name in scripts:
+                os.unlink(os.path.join(script_dir, name))
+            os.rmdir(script_dir)
+        
+        print(f"\n{GREEN if passed == len(scripts) else YELLOW}Passed {passed}/{len(scripts)} CGI cache tests{RESET}")
+        return passed == len(scripts)
+    
+    def test_metrics(self):
+        """Test 7c: /metrics is a valid Prometheus text exposition"""
+        self.print_test_header("Metrics Endpoint")
+        
+        # something to count first
+        subprocess.run("curl -s -o /dev/null http://127.0.0.1:8888/index.html", shell=True, timeout=5)
+        status, headers, body = self.fetch("", "http://127.0.0.1:8888/metrics")
+        lines = body.decode(errors='replace').splitlines()
+        
+        sample_re = re.compile(r'^([a-zA-Z_:][a-zA-Z0-9_:]*)(\{(?:[a-zA-Z_][a-zA-Z0-9_]*="(?:[^"\\]|\\.)*",?)*\})? (\S+)$')
+        helps, types, order, seen, errors = {}, {}, [], set(), []
+        family = None
+        for line in lines:
+            if line.startswith("# HELP ") or line.startswith("# TYPE "):
+                name = line.split(" ")[2]
+                table = helps if line.startswith("# HELP ") else types
+                table[name] = table.get(name, 0) + 1
+                if name != family:
+                    order.append(name)
+                family = name
+                continue
+            match = sample_re.match(line)
+            if not match:
+                errors.append(f"unparsable line {line!r}")
+                continue
+            name, labels, value = match.groups()
+            try:
+                float(value)
+            except ValueError:
+                errors.append(f"bad value in {line!r}")
+            # histogram samples belong to the family they extend
+            base = re.sub(r'_(bucket|sum|count)$', '', name) if family and name != family else name
+            if base != family:
+                errors.append(f"{name} is outside its family block (current family {family})")
+            if (name, labels) in seen:
+                errors.append(f"duplicate sample {name}{labels or ''}")
+            seen.add((name, labels))
+        
+        checks = [
+            ("returns 200 as text/plain version 0.0.4",
+             status.split(" ")[1:2] == ["200"] and headers.get("content-type", "").startswith("text/plain; version=0.0.4")),
+            ("every line parses, with one block per family and no duplicate sample",
+             not errors),
+            ("every family has exactly one HELP and one TYPE",
+             bool(order) and len(order) == len(set(order)) and all(helps.get(n) == 1 and types.get(n) == 1 for n in order)),
+            ("the request just made is counted",
+             any(l.startswith("webserv_requests_total{") and 'location="/index.html"' in l for l in lines)),
+        ]
+        passed = 0
+        for label, ok in checks:
+            if ok:
+                print(f"{GREEN}✓ /metrics {label}{RESET}")
+                passed += 1
+            else:
+                print(f"{RED}✗ /metrics {label}{RESET}")
+        for error in errors[:5]:
+            print(f"{RED}  {error}{RESET}")
+        
+        print(f"\n{GREEN if passed == len(checks) else YELLOW}Passed {passed}/{len(checks)} metrics tests{RESET}")
+        return passed == len(checks)
+    
+    def test_access_log(self):
+        """Test 7d: access_log writes one formatted line per request"""
+        self.print_test_header("Access Log")
+        
+        log_fd, log_path = tempfile.mkstemp(suffix='.log')
+        os.close(log_fd)
+        config = f"""
+server {{
+    host 127.0.0.1;
+    listen 9996;
+    server_name log_server;
+    root ./www/;
+    access_log {log_path};
+    access_log_format $request_method $request_uri $status $bytes_sent $server_port;
+    
+    location / {{
+        index index.html;
+        allowed_methods GET;
+    }}
+    location /index.html {{
+        index index.html;
+        allowed_methods GET;
+    }}
+}}
+"""
+        fd, config_path = tempfile.mkstemp(suffix='.conf')
+        with os.fdopen(fd, 'w') as f:
+            f.write(config)
+        
+        requests = [("/index.html", 200), ("/missing.html", 404)]
+        passed = 0
+        server = None
+        try:
+            server = subprocess.Popen([self.binary_path, config_path],
+                                      stdout=subprocess.PIPE,
+                                      stderr=subprocess.PIPE)
+            time.sleep(2)
+            for target, _ in requests:
+                subprocess.run(f"curl -s -o /dev/null http://127.0.0.1:9996{target}", shell=True, timeout=5)
+            time.sleep(1)  # the log thread flushes in the background
+            with open(log_path) as f:
+                lines = f.read().splitlines()
+            for target, status in requests:
+                fields = [line.split(" ") for line in lines if line.startswith(f"GET {target} ")]
+                if (len(fields) == 1 and fields[0][2:3] == [str(status)]
+                        and fields[0][3].isdigit() and int(fields[0][3]) > 0 and fields[0][4:] == ["9996"]):
+                    print(f"{GREEN}✓ GET {target} was logged once with status {status}{RESET}")
+                    passed += 1
+                else:
+                    print(f"{RED}✗ GET {target} was not logged as expected: {lines}{RESET}")
+        except Exception as e:
+            print(f"{RED}✗ Error testing access log: {e}{RESET}")
+        finally:
+            if server:
+                server.terminate()
+                server.wait(timeout=5)
+            os.unlink(config_path)
+            os.unlink(log_path)
+        
+        print(f"\n{GREEN if passed == len(requests) else YELLOW}Passed {passed}/{len(requests)} access log tests{RESET}")
+        return passed == len(requests)
+    
     def test_cookies(self):
         """Test 8: Cookie/Session functionality"""
         self.print_test_header("Cookie/Session Tests")
@@ -447,10 +942,20 @@ server {
         
         # Run tests that require server to be running
         test_results.append(("Error Codes", self.test_error_codes()))
+        test_results.append(("Keep-Alive After Errors", self.test_keep_alive_errors()))
+        test_results.append(("Binary Files", self.test_binary_files()))
+        test_results.append(("Ranges", self.test_ranges()))
+        test_results.append(("Conditional Requests", self.test_conditional_requests()))
+        test_results.append(("gzip_static", self.test_gzip_static()))
+        test_results.append(("gzip", self.test_gzip_responses()))
         test_results.append(("File Uploads", self.test_file_uploads()))
+        test_results.append(("Multipart Uploads", self.test_multipart_uploads()))
         test_results.append(("Permissions", self.test_permission_errors()))
         test_results.append(("Autoindex", self.test_autoindex()))
         test_results.append(("CGI", self.test_cgi()))
+        test_results.append(("CGI Cache", self.test_cgi_cache_private()))
+        test_results.append(("Metrics", self.test_metrics()))
+        test_results.append(("Access Log", self.test_access_log()))
         test_results.append(("Cookies", self.test_cookies()))
         
         # Stop server for config tests
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Allocation budget test for webserv
+Runs the counting build (make webserv_alloc), sends keep-alive static GETs
+on one connection and fails when a phase of a request allocates more than
+its budget, so a regression is reported in the phase that caused it.
+usage: python3 tester/alloc_budget.py ./webserv_alloc [--budget PHASE=N ...]
+"""
+
+import argparse
+import os
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+RED = '\033[91m'
+GREEN = '\033[92m'
+BLUE = '\033[94m'
+RESET = '\033[0m'
+
+PHASES = ["accept", "parse", "route", "handle", "write", "other"]
+# Measured on a keep-alive GET of /style/style.css. The handle phase keeps
+# the SingleFlight entry of the request (a map node and two copies of its
+# key) and the FileBody handed to the client (the object and its parts).
+BUDGETS = {"accept": 0, "parse": 0, "route": 0, "handle": 5, "write": 0, "other": 0, "total": 5}
+
+
+def read_report(process, path):
+    """Has the server write its counters and parses them"""
+    if os.path.exists(path):
+        os.remove(path)
+    time.sleep(0.1)  # the last response is counted once the loop is done with it
+    process.send_signal(signal.SIGUSR1)
+    for _ in range(50):
+        if os.path.exists(path) and open(path).read().endswith("\n"):
+            break
+        time.sleep(0.02)
+    report = {"requests": 0}
+    for line in open(path):
+        fields = dict(field.split("=", 1) for field in line.split())
+        if "phase" in fields:
+            report[fields["phase"]] = (int(fields["allocs"]), int(fields["bytes"]))
+        else:
+            report["requests"] = int(fields["requests"])
+    return report
+
+
+def get(sock, path):
+    """Sends one keep-alive GET and reads the whole response"""
+    sock.sendall(f"GET {path} HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n".encode())
+    data = b""
+    while b"\r\n\r\n" not in data:
+        data += sock.recv(65536)
+    head, _, body = data.partition(b"\r\n\r\n")
+    length = 0
+    for line in head.split(b"\r\n"):
+        if line.lower().startswith(b"content-length:"):
+            length = int(line.split(b":")[1])
+    while len(body) < length:
+        body += sock.recv(65536)
+    return head.split(b"\r\n")[0]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("binary", nargs="?", default="./webserv_alloc")
+    parser.add_argument("--config", default="config/example.conf")
+    parser.add_argument("--port", type=int, default=8888)
+    parser.add_argument("--path", default="/style/style.css")
+    parser.add_argument("--requests", type=int, default=1000)
+    parser.add_argument("--budget", action="append", default=[], metavar="PHASE=N",
+                        help="allocations per request allowed in a phase (or total), repeatable")
+    args = parser.parse_args()
+    budgets = dict(BUDGETS)
+    for budget in args.budget:
+        phase, _, limit = budget.partition("=")
+        if phase not in budgets or not limit.isdigit():
+            parser.error(f"--budget {budget}: expected PHASE=N with PHASE in {', '.join(budgets)}")
+        budgets[phase] = int(limit)
+
+    report_path = os.path.join(tempfile.mkdtemp(), "alloc_report")
+    env = dict(os.environ, ALLOC_REPORT=report_path)
+    server = subprocess.Popen([args.binary, args.config], env=env,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        sock = None
+        for _ in range(50):
+            try:
+                sock = socket.create_connection(("127.0.0.1", args.port))
+                break
+            except OSError:
+                time.sleep(0.1)
+        time.sleep(0.2)
+        if sock is None or server.poll() is not None:
+            print(f"{RED}✗ server did not start (port {args.port} already in use?){RESET}")
+            return 1
+        # warm up: pools, caches and buffers reach their steady size
+        for _ in range(100):
+            status = get(sock, args.path)
+        if not status.startswith(b"HTTP/1.1 200"):
+            print(f"{RED}✗ GET {args.path}: {status.decode()}{RESET}")
+            return 1
+        before = read_report(server, report_path)
+        for _ in range(args.requests):
+            get(sock, args.path)
+        after = read_report(server, report_path)
+        sock.close()
+    finally:
+        if server.poll() is None:
+            server.send_signal(signal.SIGINT)
+            server.wait(timeout=5)
+
+    requests = after["requests"] - before["requests"]
+    if requests != args.requests:
+        print(f"{RED}✗ {requests} requests counted, {args.requests} sent{RESET}")
+        return 1
+    print(f"{BLUE}Keep-alive GET {args.path}, per request over {requests} requests{RESET}")
+    # a container that grows once every few dozen requests shows up as a
+    # fraction: a phase is over budget once it rounds above it
+    total = 0
+    over = []
+    for phase in PHASES:
+        allocs = (after[phase][0] - before[phase][0]) / requests
+        size = (after[phase][1] - before[phase][1]) / requests
+        total += allocs
+        mark = ""
+        if round(allocs) > budgets[phase]:
+            over.append(phase)
+            mark = f"{RED}  over budget ({budgets[phase]}){RESET}"
+        print(f"  {phase:<8} {allocs:8.2f} allocs {size:10.1f} bytes{mark}")
+    if round(total) > budgets["total"]:
+        over.append("total")
+    if over:
+        print(f"{RED}✗ {total:.2f} allocations per request, over budget in {', '.join(over)}{RESET}")
+        return 1
+    print(f"{GREEN}✓ {total:.2f} allocations per request, budget is {budgets['total']}{RESET}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,201 @@
+#include "../server/AllocStats.hpp"
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+*	Counting allocator linked into webserv_alloc only. malloc, calloc,
+*	realloc and every operator new are charged to the phase the calling
+*	thread is in (see AllocStats.hpp), then handed to glibc.
+*	kill -USR1 writes the totals to $ALLOC_REPORT (stderr when unset),
+*	and they are written once more at exit:
+*		phase=<name> allocs=<n> bytes=<n> allocs/req=<n> bytes/req=<n>
+*		requests=<n>
+*/
+
+extern "C" void*	__libc_malloc(size_t size);
+extern "C" void*	__libc_calloc(size_t count, size_t size);
+extern "C" void*	__libc_realloc(void* ptr, size_t size);
+extern "C" void		__libc_free(void* ptr);
+
+namespace
+{
+	const char*	PHASE_NAMES[allocstats::PHASES] = { "other", "accept", "parse", "route", "handle", "write" };
+
+	__thread int			currentPhase = allocstats::OTHER;
+	volatile unsigned long	allocs[allocstats::PHASES];
+	volatile unsigned long	bytes[allocstats::PHASES];
+	volatile unsigned long	requests;
+	char					reportPath[4096];
+
+	inline void	count(size_t size)
+	{
+		__sync_fetch_and_add(&allocs[currentPhase], 1);
+		__sync_fetch_and_add(&bytes[currentPhase], size);
+	}
+
+	// the report is written from a signal handler: no stdio, no allocation
+	size_t	append(char* out, size_t at, const char* str)
+	{
+		size_t length = std::strlen(str);
+		std::memcpy(out + at, str, length);
+		return (at + length);
+	}
+
+	size_t	append(char* out, size_t at, unsigned long value)
+	{
+		char digits[24];
+		size_t length = 0;
+		do {
+			digits[length++] = '0' + value % 10;
+			value /= 10;
+		} while (value);
+		while (length)
+			out[at++] = digits[--length];
+		return (at);
+	}
+
+	void	report()
+	{
+		char out[1024];
+		size_t at = 0;
+		unsigned long done = requests;
+		for (int phase = 0; phase < allocstats::PHASES; phase++)
+		{
+			at = append(out, at, "phase=");
+			at = append(out, at, PHASE_NAMES[phase]);
+			at = append(out, at, " allocs=");
+			at = append(out, at, allocs[phase]);
+			at = append(out, at, " bytes=");
+			at = append(out, at, bytes[phase]);
+			at = append(out, at, " allocs/req=");
+			at = append(out, at, done ? allocs[phase] / done : 0);
+			at = append(out, at, " bytes/req=");
+			at = append(out, at, done ? bytes[phase] / done : 0);
+			at = append(out, at, "\n");
+		}
+		at = append(out, at, "requests=");
+		at = append(out, at, done);
+		at = append(out, at, "\n");
+		int fd = reportPath[0] ? open(reportPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : 2;
+		if (fd == -1)
+			return ;
+		ssize_t written = write(fd, out, at);
+		if (fd != 2)
+			close(fd);
+		(void)written;
+	}
+
+	void	onReportSignal(int)
+	{
+		report();
+	}
+
+	struct Setup
+	{
+		Setup()
+		{
+			const char* path = std::getenv("ALLOC_REPORT");
+			if (path && std::strlen(path) < sizeof(reportPath))
+				std::strcpy(reportPath, path);
+			struct sigaction action;
+			std::memset(&action, 0, sizeof(action));
+			action.sa_handler = onReportSignal;
+			action.sa_flags = SA_RESTART;
+			sigaction(SIGUSR1, &action, NULL);
+		}
+		~Setup()
+		{
+			report();
+		}
+	};
+	Setup	setup;
+}
+
+allocstats::Phase	allocstats::enter(Phase phase)
+{
+	Phase previous = static_cast<Phase>(currentPhase);
+	currentPhase = phase;
+	return (previous);
+}
+
+void	allocstats::leave(Phase previous)
+{
+	currentPhase = previous;
+}
+
+void	allocstats::requestDone()
+{
+	__sync_fetch_and_add(&requests, 1);
+}
+
+extern "C" void*	malloc(size_t size)
+{
+	count(size);
+	return (__libc_malloc(size));
+}
+
+extern "C" void*	calloc(size_t countOf, size_t size)
+{
+	count(countOf * size);
+	return (__libc_calloc(countOf, size));
+}
+
+extern "C" void*	realloc(void* ptr, size_t size)
+{
+	count(size);
+	return (__libc_realloc(ptr, size));
+}
+
+extern "C" void	free(void* ptr)
+{
+	__libc_free(ptr);
+}
+
+void*	operator new(size_t size) throw(std::bad_alloc)
+{
+	count(size);
+	void* memory = __libc_malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return (memory);
+}
+
+void*	operator new[](size_t size) throw(std::bad_alloc)
+{
+	return (operator new(size));
+}
+
+void*	operator new(size_t size, const std::nothrow_t&) throw()
+{
+	count(size);
+	return (__libc_malloc(size ? size : 1));
+}
+
+void*	operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	return (operator new(size, std::nothrow));
+}
+
+void	operator delete(void* ptr) throw()
+{
+	__libc_free(ptr);
+}
+
+void	operator delete[](void* ptr) throw()
+{
+	__libc_free(ptr);
+}
+
+void	operator delete(void* ptr, const std::nothrow_t&) throw()
+{
+	__libc_free(ptr);
+}
+
+void	operator delete[](void* ptr, const std::nothrow_t&) throw()
+{
+	__libc_free(ptr);
+}
@@ -0,0 +1,94 @@
+#include "../server/Client.hpp"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+/*
+*	Cost of setting up and tearing down a connection object, from the
+*	slab pool (what accept and closeClient do) against the general heap.
+*	Bursts keep many connections open at once, churn opens and closes one
+*	at a time. No socket is involved: the fd is -1, so only the object
+*	itself is measured.
+*	usage: ./client_bench [connections per burst] [rounds]
+*/
+
+static double	now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static Client*	heapClient(const struct sockaddr_in& peer)
+{
+	void* memory = ::operator new(sizeof(Client));
+	return (::new (memory) Client(-1, peer, 8080));
+}
+
+static void	heapRelease(Client* client)
+{
+	client->~Client();
+	::operator delete(client);
+}
+
+static double	burst(bool pooled, std::vector<Client *>& open, size_t rounds, const struct sockaddr_in& peer)
+{
+	double start = now();
+	for (size_t round = 0; round < rounds; round++)
+	{
+		for (size_t i = 0; i < open.size(); i++)
+			open[i] = pooled ? new Client(-1, peer, 8080) : heapClient(peer);
+		for (size_t i = 0; i < open.size(); i++)
+		{
+			if (pooled)
+				delete open[i];
+			else
+				heapRelease(open[i]);
+		}
+	}
+	return ((now() - start) / (rounds * open.size()));
+}
+
+static double	churn(bool pooled, size_t count, const struct sockaddr_in& peer)
+{
+	double start = now();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (pooled)
+			delete new Client(-1, peer, 8080);
+		else
+			heapRelease(heapClient(peer));
+	}
+	return ((now() - start) / count);
+}
+
+int	main(int argc, char** argv)
+{
+	size_t connections = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 10000;
+	size_t rounds = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 100;
+	if (connections == 0 || rounds == 0)
+	{
+		std::cerr << "usage: ./client_bench [connections per burst] [rounds]" << std::endl;
+		return (1);
+	}
+	struct sockaddr_in peer;
+	std::memset(&peer, 0, sizeof(peer));
+	peer.sin_family = AF_INET;
+	std::vector<Client *> open(connections);
+
+	// warm both allocators so neither pays for its first growth
+	burst(true, open, 1, peer);
+	burst(false, open, 1, peer);
+	std::cout << "sizeof(Client): " << sizeof(Client) << " bytes" << std::endl;
+	std::cout << "burst of " << connections << ", " << rounds << " rounds" << std::endl;
+	std::cout << "  slab pool: " << burst(true, open, rounds, peer) << " ns per connection" << std::endl;
+	std::cout << "  heap:      " << burst(false, open, rounds, peer) << " ns per connection" << std::endl;
+	std::cout << "churn of " << connections * rounds << std::endl;
+	std::cout << "  slab pool: " << churn(true, connections * rounds, peer) << " ns per connection" << std::endl;
+	std::cout << "  heap:      " << churn(false, connections * rounds, peer) << " ns per connection" << std::endl;
+	std::cout << "pool capacity: " << Client::getPool().capacity() << " objects" << std::endl;
+	return (0);
+}
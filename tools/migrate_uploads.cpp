@@ -0,0 +1,52 @@
+#include "../server/uploads.hpp"
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/*
+*	Moves the files lying flat in an upload directory into the shard tree
+*	the server now writes to. rename() is atomic and the server looks in
+*	the shard before the flat directory, so it can run while serving.
+*	usage: ./migrate_uploads [upload_dir]
+*/
+int	main(int argc, char** argv)
+{
+	std::string root = (argc > 1) ? argv[1] : UPLOAD_PATH;
+	if (root.empty() || root[root.size() - 1] != '/')
+		root += "/";
+	DIR* dir = opendir(root.c_str());
+	if (dir == NULL)
+	{
+		std::cerr << "migrate_uploads: " << root << ": " << strerror(errno) << std::endl;
+		return (1);
+	}
+	std::vector<std::string> names;
+	struct dirent* entry;
+	while ((entry = readdir(dir)))
+	{
+		if (entry->d_type == DT_REG)
+			names.push_back(entry->d_name);
+	}
+	closedir(dir);
+
+	size_t moved = 0, skipped = 0;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		std::string target = uploads::shardDir(names[i], root) + names[i];
+		struct stat info;
+		if (!uploads::makeShardDir(names[i], root) || lstat(target.c_str(), &info) == 0
+			|| std::rename((root + names[i]).c_str(), target.c_str()) != 0)
+		{
+			std::cerr << "migrate_uploads: skipped " << names[i] << std::endl;
+			skipped++;
+			continue;
+		}
+		moved++;
+	}
+	std::cout << moved << " file(s) moved to " << root << UPLOAD_STORE << ", " << skipped << " skipped" << std::endl;
+	return (skipped == 0 ? 0 : 1);
+}